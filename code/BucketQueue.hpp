@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <vector>
+
+// Monotone priority queue for small integer keys in [minKey, maxKey]. Items
+// are popped by decreasing key, and by increasing class within a key. An item
+// may only be pushed if it does not come before the last popped item in that
+// order. The pop cursor then only moves down the key range, so push and pop
+// take O(1) amortized time. The queue can be reused once it is empty.
+template<class T, int Classes>
+class BucketQueue {
+public:
+	struct Entry {
+		int key;
+		int cls;
+		T item;
+	};
+
+	BucketQueue(int minKey, int maxKey):
+		minKey(minKey), buckets(maxKey-minKey+1) {}
+
+	bool empty() const { return count == 0; }
+
+	void push(int key, int cls, const T& item) {
+		int b = key - minKey;
+		assert(b >= 0 && b < (int)buckets.size());
+		assert(cls >= 0 && cls < Classes);
+		assert(!popped || b < cursor || (b == cursor && cls >= curClass));
+		buckets[b][cls].push_back(item);
+		if (b > cursor) cursor = b;
+		++count;
+	}
+
+	Entry pop() {
+		assert(count > 0);
+		popped = true;
+		while(true) {
+			auto& bucket = buckets[cursor];
+			for(; curClass<Classes; ++curClass) {
+				auto& items = bucket[curClass];
+				if (items.empty()) continue;
+				Entry e{cursor + minKey, curClass, items.back()};
+				items.pop_back();
+				if (--count == 0) {
+					cursor = -1;
+					curClass = 0;
+					popped = false;
+				}
+				return e;
+			}
+			--cursor;
+			curClass = 0;
+		}
+	}
+
+private:
+	int minKey;
+	std::vector<std::array<std::vector<T>, Classes>> buckets;
+	int cursor = -1;
+	int curClass = 0;
+	int count = 0;
+	bool popped = false;
+};
@@ -0,0 +1,59 @@
+#include "BucketQueue.hpp"
+#include <algorithm>
+#include <random>
+#include <tuple>
+#include <gtest/gtest.h>
+
+namespace {
+
+using namespace std;
+
+TEST(BucketQueueTest, PopsByKeyThenClass) {
+	BucketQueue<int, 3> queue(-5, 5);
+	queue.push(2, 1, 10);
+	queue.push(-3, 0, 11);
+	queue.push(2, 0, 12);
+	queue.push(4, 2, 13);
+	vector<int> order;
+	while(!queue.empty()) order.push_back(queue.pop().item);
+	EXPECT_EQ(order, vector<int>({13, 12, 10, 11}));
+}
+
+TEST(BucketQueueTest, MonotonePushesWhilePopping) {
+	for(int run=0; run<100; ++run) {
+		mt19937 rng(run);
+		BucketQueue<int, 3> queue(-20, 20);
+		vector<tuple<int,int>> expected;
+		for(int i=0; i<10; ++i) {
+			int key = (int)(rng()%41) - 20, cls = rng()%3;
+			queue.push(key, cls, 0);
+			expected.emplace_back(-key, cls);
+		}
+		vector<tuple<int,int>> actual;
+		while(!queue.empty()) {
+			auto e = queue.pop();
+			actual.emplace_back(-e.key, e.cls);
+			if (rng()%2 && e.key > -20) {
+				int key = e.key - (int)(rng()%(e.key+21));
+				int cls = key == e.key ? e.cls + (int)(rng()%(3-e.cls)) : rng()%3;
+				queue.push(key, cls, 0);
+				expected.emplace_back(-key, cls);
+			}
+		}
+		sort(expected.begin(), expected.end());
+		EXPECT_EQ(actual, expected);
+	}
+}
+
+TEST(BucketQueueTest, Reuse) {
+	BucketQueue<int, 2> queue(0, 10);
+	queue.push(3, 1, 1);
+	EXPECT_EQ(queue.pop().item, 1);
+	EXPECT_TRUE(queue.empty());
+	queue.push(8, 0, 2);
+	queue.push(9, 1, 3);
+	EXPECT_EQ(queue.pop().item, 3);
+	EXPECT_EQ(queue.pop().item, 2);
+}
+
+} // namespace
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Box.hpp"
+#include "decomposition.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+// Maps every axis to the ranks of its distinct coordinates. The coordinates
+// are the obstacle bounds and the cell bounds of the given points. The space
+// between two consecutive coordinates contains no obstacle boundary, so it
+// shrinks to a single unit without changing the link distance between any of
+// the given points. Other points may fall inside a shrunk unit together with
+// their neighbours, so their distances are not kept. The points must thus be
+// known when compressing, which is why only the one-shot functions of
+// path.hpp compress and LinkDistanceIndex works on the original coordinates.
+template<int D>
+class CoordinateCompression {
+public:
+	CoordinateCompression(const ObstacleSet<D>& obstacles, const std::vector<Point<D>>& points) {
+		for(const Obstacle<D>& obs: obstacles) {
+			for(int i=0; i<D; ++i) {
+				coords[i].push_back(obs.box[i].from);
+				coords[i].push_back(obs.box[i].to);
+			}
+		}
+		for(const Point<D>& p: points) {
+			for(int i=0; i<D; ++i) {
+				coords[i].push_back(p[i]);
+				coords[i].push_back(p[i]+1);
+			}
+		}
+		for(int i=0; i<D; ++i) sortUnique(coords[i]);
+	}
+
+	// Rank of the last coordinate at or before x on the given axis.
+	int compress(int axis, int x) const {
+		const auto& c = coords[axis];
+		return std::upper_bound(c.begin(), c.end(), x) - c.begin() - 1;
+	}
+	int expand(int axis, int rank) const {
+		return coords[axis][rank];
+	}
+
+	Point<D> compress(Point<D> p) const {
+		for(int i=0; i<D; ++i) p[i] = compress(i, p[i]);
+		return p;
+	}
+	Point<D> expand(Point<D> p) const {
+		for(int i=0; i<D; ++i) p[i] = expand(i, p[i]);
+		return p;
+	}
+
+	Box<D> compress(Box<D> box) const {
+		for(int i=0; i<D; ++i) {
+			box[i] = {compress(i, box[i].from), compress(i, box[i].to)};
+		}
+		return box;
+	}
+
+	ObstacleSet<D> compress(const ObstacleSet<D>& obstacles) const {
+		ObstacleSet<D> result;
+		result.reserve(obstacles.size());
+		for(const Obstacle<D>& obs: obstacles) {
+			result.push_back({compress(obs.box), obs.direction});
+		}
+		return result;
+	}
+
+	// Number of distinct coordinates on each axis.
+	std::array<int, D> size() const {
+		std::array<int, D> res;
+		for(int i=0; i<D; ++i) res[i] = coords[i].size();
+		return res;
+	}
+
+private:
+	std::vector<int> coords[D];
+};
@@ -0,0 +1,23 @@
+#include "CoordinateCompression.hpp"
+#include <gtest/gtest.h>
+
+namespace {
+
+using namespace std;
+
+TEST(CoordinateCompressionTest, RanksDistinctCoordinates) {
+	ObstacleSet<2> obs = {
+		{{{{10, 40}, {20, 20}}}, 2},
+		{{{{40, 40}, {20, 100}}}, 1}};
+	CoordinateCompression<2> cc(obs, {{15, 30}});
+	EXPECT_EQ(cc.size(), (array<int, 2>{{4, 4}}));
+	ObstacleSet<2> res = cc.compress(obs);
+	EXPECT_EQ(res[0].box, (Box<2>{{{0, 3}, {0, 0}}}));
+	EXPECT_EQ(res[1].box, (Box<2>{{{3, 3}, {0, 3}}}));
+	EXPECT_EQ(res[1].direction, 1);
+	EXPECT_EQ(cc.compress(Point<2>{15, 30}), (Point<2>{1, 1}));
+	EXPECT_EQ(cc.expand(Point<2>{1, 1}), (Point<2>{15, 30}));
+	EXPECT_EQ(cc.compress(Point<2>{20, 50}), (Point<2>{2, 2}));
+}
+
+} // namespace
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Box.hpp"
+
+#include <algorithm>
+#include <vector>
+
+// Point location among disjoint boxes. A kd-tree splits the boxes at the
+// median lower bound on the widest axis. Boxes crossing a split are stored on
+// both sides, so a query follows a single root-to-leaf path and tests only the
+// few boxes of one leaf.
+template<int D>
+class PointLocator {
+public:
+	PointLocator() {}
+
+	explicit PointLocator(const std::vector<Box<D>>& boxes): boxes(boxes) {
+		std::vector<int> idx(boxes.size());
+		for(size_t i=0; i<idx.size(); ++i) idx[i] = i;
+		build(idx, 0);
+	}
+
+	// Returns the index of the box containing pt, or -1 if there is none.
+	int locate(const Point<D>& pt) const {
+		if (nodes.empty()) return -1;
+		int n = 0;
+		while(nodes[n].axis >= 0) {
+			const Node& node = nodes[n];
+			n = pt[node.axis] < node.split ? node.left : node.right;
+		}
+		for(int i=nodes[n].left; i<nodes[n].right; ++i) {
+			if (boxes[items[i]].contains(pt)) return items[i];
+		}
+		return -1;
+	}
+
+private:
+	// Inner nodes split at axis; leaves have axis -1 and store their items
+	// in items[left..right).
+	struct Node {
+		int axis = -1;
+		int split = 0;
+		int left = 0;
+		int right = 0;
+	};
+
+	static constexpr int LEAF_SIZE = 4;
+
+	int build(std::vector<int>& idx, int depth) {
+		int n = nodes.size();
+		nodes.emplace_back();
+		std::vector<int> lo, hi;
+		int split = 0;
+		int axis = (int)idx.size() > LEAF_SIZE && depth < 64 ? chooseSplit(idx, split, lo, hi) : -1;
+		if (axis < 0) {
+			nodes[n].left = items.size();
+			items.insert(items.end(), idx.begin(), idx.end());
+			nodes[n].right = items.size();
+			return n;
+		}
+		std::vector<int>().swap(idx);
+		int left = build(lo, depth+1);
+		int right = build(hi, depth+1);
+		nodes[n] = {axis, split, left, right};
+		return n;
+	}
+
+	// Tries the axes from the widest to the narrowest and returns the first
+	// one whose median split shrinks both sides, or -1 if none does.
+	int chooseSplit(const std::vector<int>& idx, int& split,
+			std::vector<int>& lo, std::vector<int>& hi) const {
+		Box<D> bounds = boxes[idx[0]];
+		for(int i: idx) {
+			for(int d=0; d<D; ++d) bounds[d] = bounds[d].union_(boxes[i][d]);
+		}
+		int axes[D];
+		for(int d=0; d<D; ++d) axes[d] = d;
+		std::sort(axes, axes+D, [&](int a, int b) {
+			return bounds[a].size() > bounds[b].size();
+		});
+		std::vector<int> coords(idx.size());
+		for(int axis: axes) {
+			for(size_t i=0; i<idx.size(); ++i) coords[i] = boxes[idx[i]][axis].from;
+			auto mid = coords.begin() + coords.size()/2;
+			std::nth_element(coords.begin(), mid, coords.end());
+			split = *mid;
+			if (split == bounds[axis].from) continue;
+			lo.clear();
+			hi.clear();
+			for(int i: idx) {
+				if (boxes[i][axis].from < split) lo.push_back(i);
+				if (boxes[i][axis].to > split) hi.push_back(i);
+			}
+			if (lo.size() < idx.size() && hi.size() < idx.size()) return axis;
+		}
+		return -1;
+	}
+
+	std::vector<Box<D>> boxes;
+	std::vector<Node> nodes;
+	std::vector<int> items;
+};
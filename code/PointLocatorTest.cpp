@@ -0,0 +1,81 @@
+#include "PointLocator.hpp"
+#include <random>
+#include <gtest/gtest.h>
+
+namespace {
+
+using namespace std;
+
+// Splits box recursively at random positions, keeping each piece with
+// probability 3/4, to get a set of disjoint boxes with gaps.
+template<int D>
+void splitRandomly(const Box<D>& box, mt19937& rng, vector<Box<D>>& result) {
+	int axis = rng()%D;
+	Range r = box[axis];
+	if (r.size() < 2 || rng()%8 == 0) {
+		if (rng()%4) result.push_back(box);
+		return;
+	}
+	int mid = r.from + 1 + rng()%(r.size()-1);
+	Box<D> a = box, b = box;
+	a[axis].to = mid;
+	b[axis].from = mid;
+	splitRandomly(a, rng, result);
+	splitRandomly(b, rng, result);
+}
+
+template<int D>
+int slowLocate(const vector<Box<D>>& boxes, const Point<D>& pt) {
+	for(size_t i=0; i<boxes.size(); ++i) {
+		if (boxes[i].contains(pt)) return i;
+	}
+	return -1;
+}
+
+template<int D>
+void testRandom(int size, int runs) {
+	for(int i=0; i<runs; ++i) {
+		mt19937 rng(i);
+		Box<D> bounds;
+		for(int j=0; j<D; ++j) bounds[j] = {0, size};
+		vector<Box<D>> boxes;
+		splitRandomly(bounds, rng, boxes);
+		PointLocator<D> locator(boxes);
+		for(int j=0; j<200; ++j) {
+			Point<D> pt;
+			for(int k=0; k<D; ++k) pt[k] = (int)(rng()%(size+2)) - 1;
+			EXPECT_EQ(locator.locate(pt), slowLocate(boxes, pt)) << pt;
+		}
+	}
+}
+
+TEST(PointLocatorTest, Empty) {
+	PointLocator<2> locator(vector<Box<2>>{});
+	EXPECT_EQ(locator.locate({0, 0}), -1);
+}
+
+TEST(PointLocatorTest, Grid) {
+	vector<Box<2>> boxes;
+	for(int x=0; x<10; ++x) {
+		for(int y=0; y<10; ++y) {
+			boxes.push_back({{{x, x+1}, {y, y+1}}});
+		}
+	}
+	PointLocator<2> locator(boxes);
+	for(int x=0; x<10; ++x) {
+		for(int y=0; y<10; ++y) {
+			EXPECT_EQ(locator.locate({x, y}), 10*x+y);
+		}
+	}
+	EXPECT_EQ(locator.locate({10, 3}), -1);
+}
+
+TEST(PointLocatorTest, Random2D) {
+	testRandom<2>(64, 20);
+}
+
+TEST(PointLocatorTest, Random3D) {
+	testRandom<3>(32, 20);
+}
+
+} // namespace
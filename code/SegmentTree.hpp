@@ -1,27 +1,68 @@
 #pragma once
 
 #include "Range.hpp"
-#include "util.hpp"
+#include "Span.hpp"
 
+#include <cassert>
+#include <utility>
 #include <vector>
 
 template<class T>
 class SegmentTree {
 public:
-	SegmentTree(int size): data(2*toPow2(size)) {}
+	// Identifies an added item for remove. Handles of removed items are
+	// reused by later adds.
+	using Handle = int;
 
+	// Works for any size: the loops below only pick nodes whose leaves all
+	// lie inside the range, even where those leaves are not contiguous.
+	SegmentTree(int size): data(2*size) {}
+
+	// Also undoes freeze.
 	void clear() {
+		if (frozen) {
+			*this = SegmentTree(size());
+			return;
+		}
 		for(auto& x: data) x.clear();
+		positions.clear();
+		freeHandles.clear();
 	}
 
-	void add(Range range, const T& item) {
+	Handle add(Range range, const T& item) {
+		assert(!frozen);
+		Handle handle = newHandle();
 		for(int a=size()+range.from+1, b=size()+range.to-1; a<=b; a/=2, b/=2) {
-			if (a&1) addRangeItem(a++, item);
-			if (!(b&1)) addRangeItem(b--, item);
+			if (a&1) addItem({a++, false, 0}, handle, item);
+			if (!(b&1)) addItem({b--, false, 0}, handle, item);
 		}
 		for(int a=size()+range.from; a>0; a/=2) {
-			addPointItem(a, item);
+			addItem({a, true, 0}, handle, item);
+		}
+		return handle;
+	}
+
+	// Removes the item added with the handle. Takes O(log n) time: the
+	// handle knows where the copies of the item are, and the last item of
+	// each of their lists is moved into their place. Removing a handle
+	// again does nothing, until a later add reuses it.
+	void remove(Handle handle) {
+		assert(!frozen);
+		if (positions[handle].empty()) return;
+		for(Position p: positions[handle]) {
+			ItemList& list = itemList(p);
+			int last = list.items.size()-1;
+			if (p.index != last) {
+				std::pair<Handle, int> moved = list.owners[last];
+				positions[moved.first][moved.second].index = p.index;
+				list.items[p.index] = std::move(list.items[last]);
+				list.owners[p.index] = moved;
+			}
+			list.items.pop_back();
+			list.owners.pop_back();
 		}
+		positions[handle].clear();
+		freeHandles.push_back(handle);
 	}
 
 	std::vector<T> find(Range range) const {
@@ -31,19 +72,70 @@ public:
 	}
 
 	void find(Range range, std::vector<T>& result) const {
-		for(int a=size()+range.from, b=size()+range.to-1; a<=b; a/=2, b/=2) {
-			if (a&1) getPointItems(a++, result);
-			if (!(b&1)) getPointItems(b--, result);
-		}
-		for(int a=size()+range.from; a>0; a/=2) {
-			getRangeItems(a, result);
-		}
+		forEachNode(range, [&](Span<const T> items) {
+			result.insert(result.end(), items.begin(), items.end());
+			return false;
+		});
+	}
+
+	// Calls visitor for every item whose range intersects the given range,
+	// until it returns true. Returns whether the visitor stopped the search.
+	template<class V>
+	bool forEach(Range range, V&& visitor) const {
+		return forEachNode(range, [&](Span<const T> items) {
+			for(const T& item: items) {
+				if (visitor(item)) return true;
+			}
+			return false;
+		});
 	}
 
+	bool any(Range range) const {
+		return forEachNode(range, [](Span<const T> items) { return items.size() > 0; });
+	}
+
+	// Same as find(range).size(), without copying the items.
+	int count(Range range) const {
+		int res = 0;
+		forEachNode(range, [&](Span<const T> items) {
+			res += items.size();
+			return false;
+		});
+		return res;
+	}
+
+	// Packs the items of all nodes into two arrays, indexed by the offsets
+	// of the nodes, and frees the per-node vectors. The tree can then only
+	// be searched until clear.
+	void freeze() {
+		if (frozen) return;
+		pack(&TreeNode::rangeItems, rangeOffsets, rangeItems);
+		pack(&TreeNode::pointItems, pointOffsets, pointItems);
+		frozenSize = size();
+		data = std::vector<TreeNode>();
+		positions = std::vector<std::vector<Position>>();
+		freeHandles.clear();
+		frozen = true;
+	}
+
+	bool isFrozen() const { return frozen; }
+
 private:
+	// The items of a node, and for each item its handle and the index of
+	// the item's position in positions[handle].
+	struct ItemList {
+		std::vector<T> items;
+		std::vector<std::pair<Handle, int>> owners;
+
+		void clear() {
+			items.clear();
+			owners.clear();
+		}
+	};
+
 	struct TreeNode {
-		std::vector<T> rangeItems;
-		std::vector<T> pointItems;
+		ItemList rangeItems;
+		ItemList pointItems;
 
 		void clear() {
 			rangeItems.clear();
@@ -51,19 +143,90 @@ private:
 		}
 	};
 
-	void addRangeItem(int index, const T& item) {
-		data[index].rangeItems.push_back(item);
+	// A copy of an item, as its node, whether it is in the node's point
+	// items, and its index there.
+	struct Position {
+		int node;
+		bool point;
+		int index;
+	};
+
+	ItemList& itemList(const Position& p) {
+		return p.point ? data[p.node].pointItems : data[p.node].rangeItems;
 	}
-	void addPointItem(int index, const T& item) {
-		data[index].pointItems.push_back(item);
+
+	void pack(ItemList TreeNode::*list, std::vector<int>& offsets, std::vector<T>& packed) {
+		offsets.assign(data.size()+1, 0);
+		for(size_t i=0; i<data.size(); ++i) {
+			offsets[i+1] = offsets[i] + (data[i].*list).items.size();
+		}
+		packed.clear();
+		packed.reserve(offsets.back());
+		for(const TreeNode& node: data) {
+			const std::vector<T>& items = (node.*list).items;
+			packed.insert(packed.end(), items.begin(), items.end());
+		}
 	}
-	void getRangeItems(int index, std::vector<T>& result) const {
-		result.insert(result.end(), data[index].rangeItems.begin(), data[index].rangeItems.end());
+
+	Handle newHandle() {
+		if (freeHandles.empty()) {
+			positions.emplace_back();
+			return positions.size()-1;
+		}
+		Handle handle = freeHandles.back();
+		freeHandles.pop_back();
+		return handle;
 	}
-	void getPointItems(int index, std::vector<T>& result) const {
-		result.insert(result.end(), data[index].pointItems.begin(), data[index].pointItems.end());
+
+	// Adds the item at the node and side given by p.
+	void addItem(Position p, Handle handle, const T& item) {
+		ItemList& list = itemList(p);
+		std::vector<Position>& own = positions[handle];
+		list.owners.emplace_back(handle, (int)own.size());
+		p.index = list.items.size();
+		own.push_back(p);
+		list.items.push_back(item);
 	}
 
-	int size() const { return data.size()/2; }
+	// Calls f with the items of every node that the search for the range
+	// reaches, until it returns true. Every item is in at most one of them.
+	template<class F>
+	bool forEachNode(Range range, F&& f) const {
+		for(int a=size()+range.from, b=size()+range.to-1; a<=b; a/=2, b/=2) {
+			if ((a&1) && f(nodePointItems(a++))) return true;
+			if (!(b&1) && f(nodePointItems(b--))) return true;
+		}
+		for(int a=size()+range.from; a>0; a/=2) {
+			if (f(nodeRangeItems(a))) return true;
+		}
+		return false;
+	}
+
+	Span<const T> nodeRangeItems(int index) const {
+		if (frozen) return packedItems(rangeOffsets, rangeItems, index);
+		return vectorItems(data[index].rangeItems.items);
+	}
+	Span<const T> nodePointItems(int index) const {
+		if (frozen) return packedItems(pointOffsets, pointItems, index);
+		return vectorItems(data[index].pointItems.items);
+	}
+	static Span<const T> packedItems(const std::vector<int>& offsets, const std::vector<T>& items, int index) {
+		return {items.data() + offsets[index], items.data() + offsets[index+1]};
+	}
+	static Span<const T> vectorItems(const std::vector<T>& items) {
+		return {items.data(), items.data() + items.size()};
+	}
+
+	int size() const { return frozen ? frozenSize : data.size()/2; }
 	std::vector<TreeNode> data;
+	// The copies of the item of every handle, and the unused handles.
+	std::vector<std::vector<Position>> positions;
+	std::vector<Handle> freeHandles;
+
+	// The packed items of the nodes after freeze. The items of node i are
+	// at offsets[i] to offsets[i+1].
+	bool frozen = false;
+	int frozenSize = 0;
+	std::vector<int> rangeOffsets, pointOffsets;
+	std::vector<T> rangeItems, pointItems;
 };
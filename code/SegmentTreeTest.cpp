@@ -1,10 +1,16 @@
 #include "SegmentTree.hpp"
+
+#include <algorithm>
+#include <random>
+
 #include <gmock/gmock-more-matchers.h>
 #include <gtest/gtest.h>
 
 namespace {
 
+using namespace std;
 using testing::UnorderedElementsAre;
+using testing::UnorderedElementsAreArray;
 
 TEST(SegmentTreeTest, AddAndLookup) {
 	SegmentTree<int> tree(10);
@@ -17,4 +23,155 @@ TEST(SegmentTreeTest, AddAndLookup) {
 	EXPECT_THAT(tree.find({0, 10}), UnorderedElementsAre(1, 2, 3, 4));
 }
 
+void checkRandom(bool freeze) {
+	mt19937 rng(1);
+	for(int size=1; size<=40; ++size) {
+		SegmentTree<int> tree(size);
+		vector<Range> ranges;
+		for(int i=0; i<20; ++i) {
+			int a = rng()%size, b = rng()%size;
+			if (a>b) swap(a,b);
+			ranges.push_back({a, b+1});
+			tree.add(ranges.back(), i);
+		}
+		if (freeze) tree.freeze();
+		for(int a=0; a<size; ++a) {
+			for(int b=a+1; b<=size; ++b) {
+				vector<int> expected;
+				for(int i=0; i<(int)ranges.size(); ++i) {
+					if (ranges[i].intersects({a, b})) expected.push_back(i);
+				}
+				EXPECT_THAT(tree.find({a, b}), UnorderedElementsAreArray(expected))<<size<<' '<<a<<' '<<b;
+				EXPECT_EQ(tree.count({a, b}), (int)expected.size());
+				EXPECT_EQ(tree.any({a, b}), !expected.empty());
+			}
+		}
+	}
+}
+
+TEST(SegmentTreeTest, RandomNonPow2) {
+	checkRandom(false);
+}
+
+TEST(SegmentTreeTest, FrozenRandomNonPow2) {
+	checkRandom(true);
+}
+
+TEST(SegmentTreeTest, ForEachStops) {
+	SegmentTree<int> tree(10);
+	tree.add({1,5}, 1);
+	tree.add({4,5}, 2);
+	tree.add({0,10}, 3);
+	vector<int> seen;
+	EXPECT_FALSE(tree.forEach({3,5}, [&](int x) { seen.push_back(x); return false; }));
+	EXPECT_THAT(seen, UnorderedElementsAre(1, 2, 3));
+	seen.clear();
+	EXPECT_TRUE(tree.forEach({3,5}, [&](int x) { seen.push_back(x); return true; }));
+	EXPECT_EQ(seen.size(), 1u);
+	EXPECT_FALSE(tree.forEach({6,7}, [](int x) { return x == 1; }));
+}
+
+// Keeps a changing set of ranges, like the active set of a sweep.
+TEST(SegmentTreeTest, RandomAddRemove) {
+	mt19937 rng(2);
+	for(int size=1; size<=30; ++size) {
+		SegmentTree<int> tree(size);
+		vector<pair<Range, int>> active;
+		vector<SegmentTree<int>::Handle> handles;
+		for(int i=0; i<200; ++i) {
+			if (!active.empty() && rng()%2) {
+				int k = rng()%active.size();
+				tree.remove(handles[k]);
+				active.erase(active.begin() + k);
+				handles.erase(handles.begin() + k);
+			} else {
+				int a = rng()%size, b = rng()%size;
+				if (a>b) swap(a,b);
+				// Equal items in the same range are removed one at a time.
+				active.push_back({{a, b+1}, (int)(rng()%5)});
+				handles.push_back(tree.add(active.back().first, active.back().second));
+			}
+			int a = rng()%size, b = rng()%size;
+			if (a>b) swap(a,b);
+			Range query{a, b+1};
+			vector<int> expected;
+			for(const auto& p: active) {
+				if (p.first.intersects(query)) expected.push_back(p.second);
+			}
+			EXPECT_THAT(tree.find(query), UnorderedElementsAreArray(expected))<<size<<' '<<i;
+		}
+	}
+}
+
+TEST(SegmentTreeTest, RemoveTwice) {
+	SegmentTree<int> tree(10);
+	auto a = tree.add({1,5}, 1);
+	tree.add({2,8}, 2);
+	tree.remove(a);
+	tree.remove(a);
+	// The handle is reused only once.
+	auto b = tree.add({0,3}, 3);
+	auto c = tree.add({4,6}, 4);
+	EXPECT_NE(b, c);
+	EXPECT_THAT(tree.find({0,10}), UnorderedElementsAre(2, 3, 4));
+	tree.remove(b);
+	EXPECT_THAT(tree.find({0,10}), UnorderedElementsAre(2, 4));
+	tree.remove(c);
+	EXPECT_THAT(tree.find({0,10}), UnorderedElementsAre(2));
+}
+
+// Counts the items that are compared, copied or moved.
+struct CountedItem {
+	static long long operations;
+	int value = 0;
+
+	CountedItem(int value): value(value) {}
+	CountedItem(const CountedItem& x): value(x.value) { ++operations; }
+	CountedItem& operator=(const CountedItem& x) {
+		value = x.value;
+		++operations;
+		return *this;
+	}
+	bool operator==(const CountedItem& x) const {
+		++operations;
+		return value == x.value;
+	}
+};
+long long CountedItem::operations = 0;
+
+// Every item has a copy in the root, so a removal that searched the nodes
+// would take time linear in the number of items.
+TEST(SegmentTreeTest, RemovalCostIsLogarithmic) {
+	const int size = 1024, items = 20000;
+	mt19937 rng(3);
+	SegmentTree<CountedItem> tree(size);
+	vector<SegmentTree<CountedItem>::Handle> handles;
+	for(int i=0; i<items; ++i) {
+		int a = rng()%size, b = rng()%size;
+		if (a>b) swap(a,b);
+		handles.push_back(tree.add({a, b+1}, i));
+	}
+	shuffle(handles.begin(), handles.end(), rng);
+	CountedItem::operations = 0;
+	for(auto handle: handles) tree.remove(handle);
+	// At most 2 log n range nodes and log n + 1 point nodes per item.
+	EXPECT_LE(CountedItem::operations, (long long)items * (3*10 + 1));
+	EXPECT_EQ(tree.count({0, size}), 0);
+}
+
+TEST(SegmentTreeTest, FreezeAndClear) {
+	SegmentTree<int> tree(10);
+	tree.add({1,5}, 1);
+	tree.add({4,5}, 2);
+	tree.freeze();
+	EXPECT_TRUE(tree.isFrozen());
+	EXPECT_THAT(tree.find({1,5}), UnorderedElementsAre(1, 2));
+	EXPECT_THAT(tree.find({5,10}), UnorderedElementsAre());
+	tree.clear();
+	EXPECT_FALSE(tree.isFrozen());
+	EXPECT_THAT(tree.find({1,5}), UnorderedElementsAre());
+	tree.add({8,9}, 3);
+	EXPECT_THAT(tree.find({0,10}), UnorderedElementsAre(3));
+}
+
 } // namespace
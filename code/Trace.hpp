@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Box.hpp"
+
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// Trace points for the decomposition and illumination sweeps. The tracer is
+// chosen at compile time: unless GRADU_TRACE is defined, Trace::event is an
+// empty inline function and the trace points compile away. With tracing
+// enabled, events are passed to the sink installed with setTraceSink. Sinks
+// must be thread safe if traced code runs on several threads.
+
+// The fields of a TraceEvent for each type, as cell, position and box. A
+// dash means the field is unused (-1 or no box).
+enum class TraceType {
+	ROUND,          // -, round number, -
+	SWEEP,          // -, sweep direction (2*axis, +1 if decreasing), -
+	ADD_RECT,       // -, sweep position, rectangle added to the plane
+	CELL,           // cell index, sweep position, -
+	OBSTACLE,       // obstacle index, sweep position, -
+	REMOVE_RECT,    // obstacle index, sweep position, obstacle in the plane
+	ILLUMINATE,     // sweep axis, sweep position, illuminated box
+	CREATE_CELL,    // -, y where the cell ends, cell box
+	INSERT_NODE,    // obstacle index, y of the event, x range of the node
+	INPUT_OBSTACLE, // obstacle index, obstacle direction, obstacle box
+	DECOMPOSITION,  // number of cells, -, -
+};
+
+// See TraceType for the meaning of cell and position.
+struct TraceEvent {
+	TraceType type = TraceType::ROUND;
+	int cell = -1;
+	int position = -1;
+	std::vector<Range> box;
+};
+
+class TraceSink {
+public:
+	virtual ~TraceSink() {}
+	virtual void record(const TraceEvent& event) = 0;
+};
+
+inline TraceSink*& traceSinkSlot() {
+	static TraceSink* sink = nullptr;
+	return sink;
+}
+
+inline void setTraceSink(TraceSink* sink) {
+	traceSinkSlot() = sink;
+}
+
+template<bool Enabled>
+struct Tracer {
+	static constexpr bool enabled = false;
+
+	template<class... Args>
+	static void event(Args&&...) {}
+};
+
+template<>
+struct Tracer<true> {
+	static constexpr bool enabled = true;
+
+	static void event(TraceType type, int cell = -1, int position = -1) {
+		TraceSink* sink = traceSinkSlot();
+		if (!sink) return;
+		sink->record({type, cell, position, {}});
+	}
+
+	template<int D>
+	static void event(TraceType type, int cell, int position, const Box<D>& box) {
+		TraceSink* sink = traceSinkSlot();
+		if (!sink) return;
+		sink->record({type, cell, position, {box.ranges, box.ranges+D}});
+	}
+};
+
+#ifdef GRADU_TRACE
+using Trace = Tracer<true>;
+#else
+using Trace = Tracer<false>;
+#endif
+
+inline std::ostream& operator<<(std::ostream& out, TraceType type) {
+	static const char* const names[] = {
+		"round", "sweep", "add", "cell", "obstacle", "remove", "illuminate",
+		"create cell", "insert node", "input obstacle", "decomposition"};
+	return out<<names[(int)type];
+}
+
+inline std::ostream& operator<<(std::ostream& out, const TraceEvent& e) {
+	out<<'{'<<e.type<<' '<<e.cell<<' '<<e.position<<" [";
+	for(Range r: e.box) out<<r;
+	return out<<"]}";
+}
+
+// Writes every event as a line of text, like the old debug output. Events
+// from several threads are written one line at a time.
+class StreamTraceSink : public TraceSink {
+public:
+	StreamTraceSink(std::ostream& out): out(out) {}
+
+	void record(const TraceEvent& event) override {
+		std::lock_guard<std::mutex> lock(mutex);
+		out<<event<<'\n';
+	}
+
+private:
+	std::ostream& out;
+	std::mutex mutex;
+};
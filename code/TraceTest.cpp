@@ -0,0 +1,78 @@
+#include "Trace.hpp"
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace {
+
+using namespace std;
+
+class RecordingSink : public TraceSink {
+public:
+	void record(const TraceEvent& event) override {
+		events.push_back(event);
+	}
+
+	vector<TraceEvent> events;
+};
+
+TEST(TraceTest, EnabledTracerRecordsEvents) {
+	RecordingSink sink;
+	setTraceSink(&sink);
+	Tracer<true>::event(TraceType::SWEEP, -1, 3);
+	Tracer<true>::event(TraceType::CELL, 5, 2, Box<2>{{{1,2}, {3,4}}});
+	setTraceSink(nullptr);
+	Tracer<true>::event(TraceType::ROUND, -1, 1);
+
+	ASSERT_EQ(sink.events.size(), 2u);
+	EXPECT_EQ(sink.events[0].type, TraceType::SWEEP);
+	EXPECT_EQ(sink.events[0].position, 3);
+	EXPECT_TRUE(sink.events[0].box.empty());
+	EXPECT_EQ(sink.events[1].type, TraceType::CELL);
+	EXPECT_EQ(sink.events[1].cell, 5);
+	ASSERT_EQ(sink.events[1].box.size(), 2u);
+	EXPECT_EQ(sink.events[1].box[1], Range(3, 4));
+}
+
+TEST(TraceTest, DisabledTracerIgnoresSink) {
+	RecordingSink sink;
+	setTraceSink(&sink);
+	Tracer<false>::event(TraceType::SWEEP, -1, 3);
+	Tracer<false>::event(TraceType::CELL, 5, 2, Box<2>{{{1,2}, {3,4}}});
+	setTraceSink(nullptr);
+	EXPECT_TRUE(sink.events.empty());
+}
+
+TEST(TraceTest, StreamSink) {
+	ostringstream oss;
+	StreamTraceSink sink(oss);
+	setTraceSink(&sink);
+	Tracer<true>::event(TraceType::REMOVE_RECT, 7, 4, Box<1>{{{0,2}}});
+	setTraceSink(nullptr);
+	EXPECT_EQ(oss.str(), "{remove 7 4 [(0..2)]}\n");
+}
+
+TEST(TraceTest, StreamSinkFromThreads) {
+	ostringstream oss;
+	StreamTraceSink sink(oss);
+	setTraceSink(&sink);
+	vector<thread> threads;
+	for(int t=0; t<4; ++t) {
+		threads.emplace_back([t]() {
+			for(int i=0; i<500; ++i) Tracer<true>::event(TraceType::CELL, t, i, Box<1>{{{0,2}}});
+		});
+	}
+	for(thread& t: threads) t.join();
+	setTraceSink(nullptr);
+	istringstream lines(oss.str());
+	int count = 0;
+	for(string line; getline(lines, line); ++count) {
+		EXPECT_EQ(line.substr(0, 6), "{cell ");
+		EXPECT_EQ(line.substr(line.size()-10), " [(0..2)]}");
+	}
+	EXPECT_EQ(count, 2000);
+}
+
+} // namespace
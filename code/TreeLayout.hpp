@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+// Memory order of the slots of one axis of a UnifiedTree. position() maps a
+// heap slot to its place in the axis. A parent must come before its
+// children.
+
+// Slots in heap order.
+struct HeapLayout {
+	HeapLayout() {}
+	explicit HeapLayout(int) {}
+
+	int position(int slot) const { return slot; }
+};
+
+// Slots in blocks of BLOCK_HEIGHT levels. Each block is stored contiguously
+// in breadth-first order and is followed by the blocks of its subtrees, so a
+// descent of BLOCK_HEIGHT levels stays within a few cache lines of flags.
+class BlockedLayout {
+public:
+	static constexpr int BLOCK_HEIGHT = 6;
+
+	BlockedLayout() {}
+	explicit BlockedLayout(int slots): positions(slots) {
+		if (slots < 2) return;
+		int next = 1;
+		std::vector<int> level, below;
+		std::vector<int> roots = {1};
+		// Lays out the blocks in depth-first order with an explicit stack.
+		while(!roots.empty()) {
+			level.assign(1, roots.back());
+			roots.pop_back();
+			for(int h=0; h<BLOCK_HEIGHT && !level.empty(); ++h) {
+				below.clear();
+				for(int x: level) {
+					positions[x] = next++;
+					if (2*x < slots) below.push_back(2*x);
+					if (2*x+1 < slots) below.push_back(2*x+1);
+				}
+				level.swap(below);
+			}
+			roots.insert(roots.end(), level.rbegin(), level.rend());
+		}
+	}
+
+	int position(int slot) const { return positions[slot]; }
+
+private:
+	std::vector<int> positions;
+};
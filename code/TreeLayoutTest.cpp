@@ -0,0 +1,47 @@
+#include "TreeLayout.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using namespace std;
+
+TEST(TreeLayoutTest, BlockedIsPermutation) {
+	for(int n=1; n<=300; ++n) {
+		BlockedLayout layout(2*n);
+		vector<int> seen(2*n);
+		for(int i=1; i<2*n; ++i) {
+			int p = layout.position(i);
+			ASSERT_GE(p, 1);
+			ASSERT_LT(p, 2*n);
+			EXPECT_EQ(seen[p]++, 0)<<n<<' '<<i;
+		}
+	}
+}
+
+TEST(TreeLayoutTest, BlockedParentFirst) {
+	for(int n=1; n<=300; ++n) {
+		BlockedLayout layout(2*n);
+		for(int i=2; i<2*n; ++i) {
+			EXPECT_LT(layout.position(i/2), layout.position(i))<<n<<' '<<i;
+		}
+	}
+}
+
+TEST(TreeLayoutTest, BlockedKeepsBlocksTogether) {
+	BlockedLayout layout(1<<14);
+	constexpr int blockSize = (1<<BlockedLayout::BLOCK_HEIGHT) - 1;
+	// The root block and the block below its leftmost leaf.
+	for(int i=1; i<=blockSize; ++i) EXPECT_EQ(layout.position(i), i);
+	int root = 1<<BlockedLayout::BLOCK_HEIGHT;
+	for(int h=0, first=root; h<BlockedLayout::BLOCK_HEIGHT; ++h, first*=2) {
+		for(int i=0; i<1<<h; ++i) {
+			EXPECT_EQ(layout.position(first+i), blockSize + (1<<h) + i);
+		}
+	}
+}
+
+} // namespace
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+
+// Statistics policies for UnifiedTree. The tree calls begin() at the start
+// of every public operation and the counting functions while it works.
+// NoStats does nothing and compiles away; CountingStats keeps totals per
+// kind of operation and the counts of the last operation. Counting in
+// check makes concurrent checks on one tree unsafe.
+
+enum class TreeOp { ADD, CHECK, CHECK_BATCH, REMOVE, BUILD };
+
+struct TreeOpStats {
+	long long calls = 0;
+	// Nodes whose flags were read or written.
+	long long nodeVisits = 0;
+	// Nodes covered by the box on every axis.
+	long long canonicalHits = 0;
+	// Nodes whose item or flags were pushed down to their children.
+	long long propagations = 0;
+	// Nodes whose flags were recomputed from their children.
+	long long recomputes = 0;
+	long long visitorCalls = 0;
+};
+
+struct NoStats {
+	static constexpr bool enabled = false;
+
+	void begin(TreeOp) {}
+	void visit() {}
+	void canonical() {}
+	void propagate() {}
+	void recompute() {}
+	void visitor() {}
+	void reset() {}
+};
+
+class CountingStats {
+public:
+	static constexpr bool enabled = true;
+
+	void begin(TreeOp op) {
+		current = &totals[(int)op];
+		++current->calls;
+		lastOp = TreeOpStats();
+		lastOp.calls = 1;
+	}
+	void visit() { ++current->nodeVisits; ++lastOp.nodeVisits; }
+	void canonical() { ++current->canonicalHits; ++lastOp.canonicalHits; }
+	void propagate() { ++current->propagations; ++lastOp.propagations; }
+	void recompute() { ++current->recomputes; ++lastOp.recomputes; }
+	void visitor() { ++current->visitorCalls; ++lastOp.visitorCalls; }
+
+	void reset() {
+		totals = {};
+		lastOp = TreeOpStats();
+	}
+
+	const TreeOpStats& total(TreeOp op) const { return totals[(int)op]; }
+	const TreeOpStats& last() const { return lastOp; }
+
+private:
+	std::array<TreeOpStats, 5> totals = {};
+	TreeOpStats lastOp;
+	TreeOpStats* current = &lastOp;
+};
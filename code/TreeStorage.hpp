@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+// Node storage for UnifiedTree. get() is for reading and may return a shared
+// empty node; ref() is for writing. References stay valid until clear().
+// prefetch() hints that a node will be read soon. forEachWritten(f) calls
+// f(i, node) for every node that may have been written since clear().
+
+// One array of all nodes, allocated up front. The written nodes are listed,
+// so clear() takes time proportional to the nodes written since the last
+// clear instead of the size of the tree.
+template<class Item>
+class DenseStorage {
+public:
+	explicit DenseStorage(long long size): data(size), written(size) {}
+
+	const Item& get(long long i) const { return data[i]; }
+	Item& ref(long long i) {
+		if (!written[i]) {
+			written[i] = true;
+			touched.push_back(i);
+		}
+		return data[i];
+	}
+	void prefetch(long long i) const { __builtin_prefetch(&data[i]); }
+
+	void clear() {
+		if (touched.size() > data.size()/8) {
+			std::fill(data.begin(), data.end(), Item());
+			std::fill(written.begin(), written.end(), false);
+		} else {
+			for(long long i: touched) {
+				data[i] = Item();
+				written[i] = false;
+			}
+		}
+		touched.clear();
+	}
+
+	template<class F>
+	void forEachWritten(F&& f) const {
+		for(long long i: touched) f(i, data[i]);
+	}
+
+	// Number of nodes written since the last clear.
+	size_t touchedCount() const { return touched.size(); }
+
+private:
+	std::vector<Item> data;
+	std::vector<bool> written;
+	std::vector<long long> touched;
+};
+
+// Nodes in fixed-size pages that are allocated on first write, found through
+// a two-level page table. Reading a node of a missing page returns an empty
+// node, so memory grows with the touched part of the tree only.
+template<class Item>
+class PagedStorage {
+public:
+	explicit PagedStorage(long long size):
+		directory(((size-1) >> (PAGE_BITS+DIR_BITS)) + 1) {}
+
+	const Item& get(long long i) const {
+		const auto& dir = directory[i >> (PAGE_BITS+DIR_BITS)];
+		if (!dir) return empty;
+		const auto& page = dir[(i >> PAGE_BITS) & DIR_MASK];
+		if (!page) return empty;
+		return page[i & PAGE_MASK];
+	}
+
+	Item& ref(long long i) {
+		auto& dir = directory[i >> (PAGE_BITS+DIR_BITS)];
+		if (!dir) dir.reset(new Page[1<<DIR_BITS]);
+		auto& page = dir[(i >> PAGE_BITS) & DIR_MASK];
+		if (!page) page.reset(new Item[1<<PAGE_BITS]());
+		return page[i & PAGE_MASK];
+	}
+
+	void prefetch(long long i) const { __builtin_prefetch(&get(i)); }
+
+	void clear() {
+		for(auto& dir: directory) dir.reset();
+	}
+
+	template<class F>
+	void forEachWritten(F&& f) const {
+		for(size_t d=0; d<directory.size(); ++d) {
+			if (!directory[d]) continue;
+			for(long long p=0; p<1<<DIR_BITS; ++p) {
+				const Page& page = directory[d][p];
+				if (!page) continue;
+				long long base = ((long long)d << (PAGE_BITS+DIR_BITS)) + (p << PAGE_BITS);
+				for(long long i=0; i<1<<PAGE_BITS; ++i) f(base + i, page[i]);
+			}
+		}
+	}
+
+	// Number of allocated pages.
+	int pages() const {
+		int res = 0;
+		for(const auto& dir: directory) {
+			if (!dir) continue;
+			for(int i=0; i<1<<DIR_BITS; ++i) res += (bool)dir[i];
+		}
+		return res;
+	}
+
+private:
+	using Page = std::unique_ptr<Item[]>;
+
+	static constexpr int PAGE_BITS = 8;
+	static constexpr int DIR_BITS = 10;
+	static constexpr long long PAGE_MASK = (1<<PAGE_BITS)-1;
+	static constexpr long long DIR_MASK = (1<<DIR_BITS)-1;
+
+	std::vector<std::unique_ptr<Page[]>> directory;
+	Item empty = Item();
+};
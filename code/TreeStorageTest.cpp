@@ -0,0 +1,69 @@
+#include "TreeStorage.hpp"
+
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+TEST(TreeStorageTest, DenseClearResetsWrittenNodes) {
+	DenseStorage<int> storage(1000);
+	storage.ref(3) = 5;
+	storage.ref(999) = 7;
+	storage.ref(3) = 6;
+	EXPECT_EQ(storage.touchedCount(), 2u);
+	EXPECT_EQ(storage.get(3), 6);
+	EXPECT_EQ(storage.get(999), 7);
+	storage.clear();
+	EXPECT_EQ(storage.touchedCount(), 0u);
+	EXPECT_EQ(storage.get(3), 0);
+	EXPECT_EQ(storage.get(999), 0);
+	storage.ref(3) = 1;
+	EXPECT_EQ(storage.touchedCount(), 1u);
+}
+
+TEST(TreeStorageTest, DenseClearManyWrites) {
+	DenseStorage<int> storage(100);
+	for(int i=0; i<100; ++i) storage.ref(i) = i;
+	storage.clear();
+	for(int i=0; i<100; ++i) EXPECT_EQ(storage.get(i), 0);
+	storage.ref(50) = 1;
+	EXPECT_EQ(storage.touchedCount(), 1u);
+}
+
+TEST(TreeStorageTest, PagedReadsMissingPagesAsEmpty) {
+	PagedStorage<int> storage(1LL<<36);
+	EXPECT_EQ(storage.get((1LL<<36) - 1), 0);
+	EXPECT_EQ(storage.pages(), 0);
+	storage.ref((1LL<<36) - 1) = 3;
+	EXPECT_EQ(storage.get((1LL<<36) - 1), 3);
+	EXPECT_EQ(storage.get((1LL<<36) - 2), 0);
+	EXPECT_EQ(storage.pages(), 1);
+	storage.clear();
+	EXPECT_EQ(storage.pages(), 0);
+	EXPECT_EQ(storage.get((1LL<<36) - 1), 0);
+}
+
+TEST(TreeStorageTest, ForEachWritten) {
+	DenseStorage<int> dense(1000);
+	PagedStorage<int> paged(1LL<<36);
+	for(long long i: {3LL, 999LL, 3LL}) {
+		dense.ref(i) = i+1;
+		paged.ref(i << 20) = i+1;
+	}
+	std::vector<std::pair<long long, int>> written;
+	dense.forEachWritten([&](long long i, int x) { written.push_back({i, x}); });
+	EXPECT_EQ(written, (std::vector<std::pair<long long, int>>{{3, 4}, {999, 1000}}));
+	// Every node of the allocated pages is visited.
+	int count = 0, sum = 0;
+	paged.forEachWritten([&](long long i, int x) {
+		++count;
+		sum += x;
+		EXPECT_EQ(x, paged.get(i));
+	});
+	EXPECT_EQ(count, 2*256);
+	EXPECT_EQ(sum, 1004);
+}
+
+} // namespace
@@ -2,18 +2,76 @@
 
 #include "Range.hpp"
 
+#include <algorithm>
+
+// Index math of a heap-ordered binary tree with n leaves in size = 2n slots.
+// The root is at slot 1 and the children of slot i are 2i and 2i+1; slots n
+// to 2n-1 are the leaves. For n that is not a power of two the leaves lie on
+// two levels. Leaves are ranked from left to right, so the deeper ones in
+// slots H to 2n-1 come first, where H is the highest power of two below 2n.
+// Every node then covers a contiguous range of ranks.
 struct TreeStructure {
 	Range indexToRange(int i) const {
-		int bits = 8*sizeof(int) - __builtin_clz(i);
-		int rs = size >> bits;
-		int st = i & ((1<<(bits-1))-1);
-		return {st*rs, (st+1)*rs};
+		return {leafRank(leftmostLeaf(i)), leafRank(rightmostLeaf(i)) + 1};
 	}
 
+	// The node covering exactly r, or the root if there is no such node.
 	int rangeToIndex(Range r) const {
-		int bits = __builtin_ffs(r.size()) - 1;
-		return ((size>>1) | r.from) >> bits;
+		int i = leafIndex(r.from);
+		while(i > 1 && indexToRange(i) != r) i /= 2;
+		return i;
+	}
+
+	int leafRank(int i) const {
+		int h = highBit(size-1);
+		return i >= h ? i - h : i + leaves() - h;
+	}
+
+	int leafIndex(int rank) const {
+		int h = highBit(size-1);
+		int i = rank + h;
+		return i < size ? i : rank - leaves() + h;
+	}
+
+	int leaves() const { return size/2; }
+
+	// The slots of the leaves with ranks in r, as at most two runs of
+	// consecutive slots: the deeper leaves have the lowest ranks but the
+	// highest slots. Returns the number of runs.
+	int leafRuns(Range r, Range runs[2]) const {
+		int deep = size - highBit(size-1);
+		int count = 0;
+		if (r.from < deep) {
+			runs[count++] = {leafIndex(r.from), leafIndex(std::min(r.to, deep)-1) + 1};
+		}
+		if (r.to > deep) {
+			runs[count++] = {leafIndex(std::max(r.from, deep)), leafIndex(r.to-1) + 1};
+		}
+		return count;
 	}
 
 	int size = 0;
+
+private:
+	static int bitLength(int x) {
+		return 8*sizeof(int) - __builtin_clz(x);
+	}
+	static int highBit(int x) {
+		return 1 << (bitLength(x) - 1);
+	}
+
+	int leftmostLeaf(int i) const {
+		int n = leaves();
+		int k = bitLength(n) - bitLength(i);
+		if (k < 0) return i;
+		i <<= k;
+		return i >= n ? i : 2*i;
+	}
+	int rightmostLeaf(int i) const {
+		int n = leaves();
+		int k = bitLength(n) - bitLength(i);
+		if (k < 0) return i;
+		i = ((i+1) << k) - 1;
+		return i >= n ? i : 2*i+1;
+	}
 };
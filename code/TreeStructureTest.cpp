@@ -1,4 +1,7 @@
 #include "TreeStructure.hpp"
+#include <algorithm>
+#include <numeric>
+#include <vector>
 #include <gtest/gtest.h>
 
 TEST(TreeStructureTest, IndexToRange) {
@@ -20,3 +23,58 @@ TEST(TreeStructureTest, RangeToIndex) {
 	EXPECT_EQ(st.rangeToIndex({2, 4}), 5);
 	EXPECT_EQ(st.rangeToIndex({0, 1}), 8);
 }
+
+TEST(TreeStructureTest, IndexToRangeNonPow2) {
+	TreeStructure st{10};
+	EXPECT_EQ(st.indexToRange(1), Range(0, 5));
+	EXPECT_EQ(st.indexToRange(2), Range(0, 3));
+	EXPECT_EQ(st.indexToRange(3), Range(3, 5));
+	EXPECT_EQ(st.indexToRange(4), Range(0, 2));
+	EXPECT_EQ(st.indexToRange(5), Range(2, 3));
+	EXPECT_EQ(st.indexToRange(8), Range(0, 1));
+	EXPECT_EQ(st.indexToRange(9), Range(1, 2));
+	EXPECT_EQ(st.indexToRange(6), Range(3, 4));
+	EXPECT_EQ(st.indexToRange(7), Range(4, 5));
+}
+
+TEST(TreeStructureTest, ChildrenSplitRange) {
+	for(int n=1; n<=40; ++n) {
+		TreeStructure st{2*n};
+		EXPECT_EQ(st.indexToRange(1), Range(0, n));
+		for(int i=1; i<n; ++i) {
+			Range r = st.indexToRange(i);
+			Range a = st.indexToRange(2*i);
+			Range b = st.indexToRange(2*i+1);
+			EXPECT_EQ(a.from, r.from)<<n<<' '<<i;
+			EXPECT_EQ(a.to, b.from)<<n<<' '<<i;
+			EXPECT_EQ(b.to, r.to)<<n<<' '<<i;
+		}
+		for(int x=0; x<n; ++x) {
+			int leaf = st.leafIndex(x);
+			EXPECT_GE(leaf, n);
+			EXPECT_EQ(st.leafRank(leaf), x);
+			EXPECT_EQ(st.rangeToIndex({x, x+1}), leaf);
+		}
+	}
+}
+
+TEST(TreeStructureTest, LeafRuns) {
+	for(int n=1; n<=40; ++n) {
+		TreeStructure st{2*n};
+		for(int from=0; from<n; ++from) {
+			for(int to=from+1; to<=n; ++to) {
+				Range runs[2];
+				int count = st.leafRuns({from, to}, runs);
+				ASSERT_GE(count, 1);
+				std::vector<int> ranks;
+				for(int k=0; k<count; ++k) {
+					for(int i=runs[k].from; i<runs[k].to; ++i) ranks.push_back(st.leafRank(i));
+				}
+				std::sort(ranks.begin(), ranks.end());
+				std::vector<int> expected(to-from);
+				std::iota(expected.begin(), expected.end(), from);
+				EXPECT_EQ(ranks, expected)<<n<<' '<<from<<' '<<to;
+			}
+		}
+	}
+}
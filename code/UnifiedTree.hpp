@@ -1,38 +1,265 @@
 #pragma once
 
 #include "Box.hpp"
+#include "Span.hpp"
+#include "TreeLayout.hpp"
+#include "TreeStats.hpp"
+#include "TreeStorage.hpp"
 #include "TreeStructure.hpp"
 #include "print.hpp"
-#include "util.hpp"
 
+#include <algorithm>
 #include <array>
-#include <bitset>
 #include <cassert>
+#include <cstdint>
 #include <iostream>
+#include <type_traits>
 #include <vector>
 
-template<class T, int D>
-class UnifiedTree {
-public:
+// Smallest unsigned type with one bit for every subset of the D axes.
+template<int D>
+using NodeFlags = std::conditional_t<D <= 3, std::uint8_t,
+	std::conditional_t<D == 4, std::uint16_t,
+	std::conditional_t<D == 5, std::uint32_t, std::uint64_t>>>;
+
+// Precomputed flag masks. subsets[m] has the bit of every subset of m, and
+// dirs[d] has the bit of every mask that does not contain axis d.
+template<int D>
+struct MaskTables {
+	using Flags = NodeFlags<D>;
+
+	constexpr MaskTables(): subsets(), dirs() {
+		for(unsigned m=0; m<1U<<D; ++m) {
+			for(unsigned i=0; i<1U<<D; ++i) {
+				if ((i & m) == i) subsets[m] |= Flags(1) << i;
+			}
+		}
+		for(int d=0; d<D; ++d) {
+			for(unsigned i=0; i<1U<<D; ++i) {
+				if (!(1 & i>>d)) dirs[d] |= Flags(1) << i;
+			}
+		}
+	}
+
+	Flags subsets[1<<D];
+	Flags dirs[D];
+};
+
+// The sizes of the axes of a tree and the offsets of their slots.
+template<int D, class Layout>
+struct TreeShape {
 	using Index = std::array<int, D>;
+	using Offset = long long;
 
-	UnifiedTree(Index sizes) {
-		int total = 1;
+	explicit TreeShape(const Index& sizes): size(sizes) {
+		Offset total = 1;
 		for(int i=D-1; i>=0; --i) {
-			int s = toPow2(sizes.begin()[i]);
-			size[i] = s;
+			layout[i] = Layout(2*size[i]);
 			stepSize[i] = total;
-			total *= 2*s;
+			total *= 2*size[i];
+			trees[i] = TreeStructure{2*size[i]};
+			ranges[i].resize(2*size[i]);
+			for(int j=1; j<2*size[i]; ++j) ranges[i][j] = trees[i].indexToRange(j);
+		}
+		Offset roots = 0;
+		for(int i=D-1; i>=0; --i) {
+			rootOffset[i] = roots;
+			roots += slotOffset(i, 1);
+		}
+	}
+
+	Range rangeForIndex(int axis, int index) const {
+		return ranges[axis][index];
+	}
+
+	Offset slotOffset(int axis, int slot) const {
+		return stepSize[axis] * layout[axis].position(slot);
+	}
+
+	Offset computeIndex(const Index& index) const {
+		Offset r=0;
+		for(int i=0; i<D; ++i) r += slotOffset(i, index[i]);
+		return r;
+	}
+
+	Offset totalSize() const {
+		Offset total = 1;
+		for(int i=0; i<D; ++i) total *= 2*size[i];
+		return total;
+	}
+
+	// Calls f(slot, covered) for the slots of the axis that an item with
+	// range r on it is stored at or passes, until f returns true: the
+	// largest slots inside r, which are covered, and all slots above them.
+	// Works bottom-up from each run of leaves, see TreeStructure::leafRuns,
+	// so a slot above both runs comes twice.
+	template<class F>
+	bool forEachSlot(int axis, Range r, F&& f) const {
+		Range runs[2];
+		int count = trees[axis].leafRuns(r, runs);
+		for(int k=0; k<count; ++k) {
+			int a, b, ap, bp;
+			for(a=runs[k].from, b=runs[k].to-1, ap=a, bp=b; a<=b; a/=2, b/=2, ap/=2, bp/=2) {
+				if (a != ap && f(ap, false)) return true;
+				if (b != bp && ap != bp && f(bp, false)) return true;
+				if ((a&1) && f(a++, true)) return true;
+				if (!(b&1) && f(b--, true)) return true;
+			}
+			for(; ap > 0; ap/=2, bp/=2) {
+				if (f(ap, false)) return true;
+				if (ap != bp && f(bp, false)) return true;
+			}
+		}
+		return false;
+	}
+
+	Index size = {};
+	std::array<Offset, D> stepSize = {};
+	std::array<Layout, D> layout;
+	std::array<TreeStructure, D> trees;
+	// The range of leaves below every slot of each axis.
+	std::array<std::vector<Range>, D> ranges;
+	// The offset of the roots of the axes after each axis.
+	std::array<Offset, D> rootOffset = {};
+};
+
+// The searches that only read the flags, shared by UnifiedTree and
+// FrozenTree. FlagStore needs get and prefetch, see TreeStorage.hpp, and
+// Stats counts the visited nodes, see TreeStats.hpp.
+template<int D, class Layout, class FlagStore, class Stats>
+class FlagSearch {
+public:
+	using Offset = long long;
+	using Flags = NodeFlags<D>;
+
+	FlagSearch(const TreeShape<D, Layout>& shape, const FlagStore& flags, Stats& stats):
+		shape(shape), flags(flags), stats(stats) {}
+
+	bool check(const Box<D>& box) const {
+		return checkRec(0, 0, 0, box);
+	}
+
+	// Sets out[k] to check(boxes[k]). Each box is searched on its own: the
+	// bottom-up searches read few nodes, and descending the tree with all
+	// boxes together cost more than it saved.
+	void checkBatch(Span<const Box<D>> boxes, std::vector<bool>& out) const {
+		out.assign(boxes.size(), false);
+		for(int k=0; k<boxes.size(); ++k) out[k] = check(boxes[k]);
+	}
+
+private:
+	using Mask = unsigned;
+
+	static bool has(Flags f, Mask m) {
+		return 1 & f>>m;
+	}
+
+	bool checkRec(Offset index, int axis, Mask covered, const Box<D>& box) const {
+		if (axis == D) {
+			stats.visit();
+			if (covered == ALL_MASK) stats.canonical();
+			return has(flags.get(index), covered ^ ALL_MASK);
 		}
-		data.resize(total);
+		if (box[axis].empty()) return false;
+		return checkAxis(index, axis, covered, box);
+	}
+
+	// Whether the tree has anything below slot i on the given axis and
+	// anywhere on the axes after it. Every add sets bit 0 on the roots of
+	// the later axes at the nodes it passes.
+	bool anyBelow(Offset next, int axis) const {
+		return has(flags.get(next + shape.rootOffset[axis]), 0);
 	}
 
+	bool checkAxis(Offset index, int axis, Mask covered, const Box<D>& box) const {
+		return shape.forEachSlot(axis, box[axis], [&](int i, bool inside) {
+			Offset slot = index + shape.slotOffset(axis, i);
+			// On the last axis checkRec reads the same node.
+			if (axis+1 < D && !anyBelow(slot, axis)) return false;
+			return checkRec(slot, axis+1, inside ? covered | (1U << axis) : covered, box);
+		});
+	}
+
+	static constexpr Mask ALL_MASK = (1U<<D)-1;
+
+	const TreeShape<D, Layout>& shape;
+	const FlagStore& flags;
+	Stats& stats;
+};
+
+template<class T, int D, template<class> class Storage, class Layout, class Stats>
+class UnifiedTree;
+
+// Read-only copy of the flags of a UnifiedTree, made by UnifiedTree::freeze.
+// It has no items and keeps only the pages of flags that have a node with
+// flags set, so the copy of a sparse tree stays small. Its queries write
+// nothing, so any number of threads may query it at once.
+template<int D, class Layout = HeapLayout>
+class FrozenTree {
+public:
+	using Index = std::array<int, D>;
+	using Flags = NodeFlags<D>;
+
+	bool check(const Box<D>& box) const {
+		NoStats stats;
+		return search(stats).check(box);
+	}
+
+	// Same as UnifiedTree::checkBatch.
+	void checkBatch(Span<const Box<D>> boxes, std::vector<bool>& out) const {
+		NoStats stats;
+		search(stats).checkBatch(boxes, out);
+	}
+
+	Index getSize() const { return shape.size; }
+
+	const PagedStorage<Flags>& flagStorage() const { return flags; }
+
+private:
+	template<class T, int E, template<class> class S, class L, class St>
+	friend class UnifiedTree;
+
+	FrozenTree(const TreeShape<D, Layout>& shape, PagedStorage<Flags> flags):
+		shape(shape), flags(std::move(flags)) {}
+
+	FlagSearch<D, Layout, PagedStorage<Flags>, NoStats> search(NoStats& stats) const {
+		return {shape, flags, stats};
+	}
+
+	TreeShape<D, Layout> shape;
+	PagedStorage<Flags> flags;
+};
+
+// Every axis of size n is a binary tree with 2n slots, see TreeStructure.hpp.
+// Storage chooses how the nodes are kept in memory, see TreeStorage.hpp.
+// PagedStorage only allocates the touched parts of the tree, which makes
+// large trees with few items cheap. The flags of the nodes and their items
+// are stored in separate arrays, so the searches only read the flags until
+// they reach an item. Layout orders the slots within each axis, see
+// TreeLayout.hpp. Stats counts the work of the operations, see TreeStats.hpp.
+template<class T, int D, template<class> class Storage = DenseStorage, class Layout = HeapLayout,
+	class Stats = NoStats>
+class UnifiedTree {
+public:
+	using Index = std::array<int, D>;
+	using Offset = long long;
+
+	UnifiedTree(Index sizes): shape(sizes), flags(shape.totalSize()), items(shape.totalSize()) {}
+
 	void add(const Box<D>& box, const T& value) {
+		stats_.begin(TreeOp::ADD);
 		addRec(0, 0, 0, box, value);
 	}
 
 	bool check(const Box<D>& box) const {
-		return checkRec(0, 0, 0, box);
+		stats_.begin(TreeOp::CHECK);
+		return search().check(box);
+	}
+
+	// Sets out[k] to check(boxes[k]), see FlagSearch::checkBatch.
+	void checkBatch(Span<const Box<D>> boxes, std::vector<bool>& out) const {
+		stats_.begin(TreeOp::CHECK_BATCH);
+		search().checkBatch(boxes, out);
 	}
 
 	void remove(Box<D> box) {
@@ -41,13 +268,56 @@ public:
 
 	template<class V>
 	void remove(Box<D> box, V&& visitor) {
+		stats_.begin(TreeOp::REMOVE);
 		for(int i=0; i<D; ++i) if (box[i].size()==0) return;
 		Index ones;
 		for(int i=0; i<D; ++i) ones[i]=1;
 		removeInSubtree(ones, 0, box, visitor);
 	}
 
-	Index getSize() const { return size; }
+	// Adds all items of a range of (box, value) pairs, with the same result
+	// as calling add for each in order. The values are first stored at the
+	// canonical nodes of their boxes, then the flags are fixed up in one
+	// bottom-up pass: over the nodes above the stored ones if there are few
+	// of them, otherwise over the whole tree.
+	template<class R>
+	void build(const R& boxes) {
+		stats_.begin(TreeOp::BUILD);
+		changed.clear();
+		std::array<std::vector<int>, D> slots;
+		for(const auto& p: boxes) {
+			const Box<D>& box = p.first;
+			bool empty = false;
+			for(int i=0; i<D; ++i) {
+				slots[i].clear();
+				canonicalSlots(i, 1, box[i], slots[i]);
+				empty |= slots[i].empty();
+			}
+			if (empty) continue;
+			Index index;
+			assignProduct(slots, index, 0, p.second);
+		}
+		Offset total = shape.totalSize(), ancestors = 1;
+		for(int i=0; i<D; ++i) {
+			ancestors *= 8*sizeof(int) - __builtin_clz(2*shape.size[i]);
+		}
+		if ((Offset)changed.size() * ancestors < total) {
+			updateChanged();
+		} else {
+			Index index;
+			updateAll(index, 0);
+		}
+	}
+
+	void clear() {
+		flags.clear();
+		items.clear();
+	}
+
+	Index getSize() const { return shape.size; }
+
+	const Stats& stats() const { return stats_; }
+	void resetStats() { stats_.reset(); }
 
 	Box<D> boxForIndex(const Index& index) const {
 		Box<D> box;
@@ -56,16 +326,35 @@ public:
 	}
 
 	Range rangeForIndex(int axis, int index) const {
-		return TreeStructure{2*size[axis]}.indexToRange(index);
+		return shape.rangeForIndex(axis, index);
+	}
+
+	using Flags = NodeFlags<D>;
+
+	const Storage<Flags>& flagStorage() const { return flags; }
+
+	// Copies the flags into a FrozenTree for concurrent checks. Only the
+	// written nodes are visited, see TreeStorage.hpp. Later changes to this
+	// tree do not affect the copy.
+	FrozenTree<D, Layout> freeze() const {
+		PagedStorage<Flags> copy(shape.totalSize());
+		flags.forEachWritten([&](Offset i, Flags f) {
+			if (f) copy.ref(i) = f;
+		});
+		return FrozenTree<D, Layout>(shape, std::move(copy));
 	}
 
 private:
-	struct Item {
-		std::bitset<1<<D> hasData;
-		T data;
-	};
+	static_assert(D >= 1 && D <= 6, "node flags need 1<<D bits");
 	using Mask = unsigned;
 
+	static bool has(Flags f, Mask m) {
+		return 1 & f>>m;
+	}
+	static Flags bit(Mask m) {
+		return Flags(1) << m;
+	}
+
 	Mask getCovered(const Index& index, const Box<D>& box) const {
 		Mask res = 0;
 		for(int i=0; i<D; ++i) {
@@ -73,123 +362,86 @@ private:
 		}
 		return res;
 	}
-	Index toIndex(int idx) const {
-		Index res = {};
-		for(int i=D-1; i>=0; --i) {
-			if (!size[i]) continue;
-			res[i] = idx % (2*size[i]);
-			idx /= 2*size[i];
-		}
-		return res;
-	}
-
-	void addRec(int index, int axis, Mask covered, const Box<D>& box, const T& value) {
+	void addRec(Offset index, int axis, Mask covered, const Box<D>& box, const T& value) {
 		if (axis == D) {
-//			std::cout<<"add "<<toIndex(index)<<' '<<covered<<' '<<box<<'\n';
-			Item& x = data[index];
-			if (covered == ALL_MASK && !x.hasData[ALL_MASK]) {
+//			std::cout<<"add "<<index<<' '<<covered<<' '<<box<<'\n';
+			stats_.visit();
+			if (covered == ALL_MASK) stats_.canonical();
+			Flags& f = flags.ref(index);
+			if (covered == ALL_MASK && !has(f, ALL_MASK)) {
 				assignItem(index, value);
 			} else {
-				for(Mask i=0; i<1<<D; ++i) {
-					if (i == (i & covered)) {
-						x.hasData.set(i);
-					}
-				}
+				f |= masks.subsets[covered];
 			}
 			return;
 		}
-		int s = size[axis];
-		int step = stepSize[axis];
-		Range range = box[axis];
-		if (range.size()==0) return;
-		int a,b,ap,bp;
-		for(a=s+range.from, b=s+range.to-1, ap=a, bp=b; a<=b; a/=2, b/=2, ap/=2, bp/=2) {
-			if (a != ap) {
-				addRec(index + step*ap, axis+1, covered, box, value);
-			}
-			if (b != bp) {
-				addRec(index + step*bp, axis+1, covered, box, value);
-			}
-			if (a&1) {
-				addRec(index + step*a++, axis+1, covered | (1U << axis), box, value);
-			}
-			if (!(b&1)) {
-				addRec(index + step*b--, axis+1, covered | (1U << axis), box, value);
-			}
-		}
-		for(; ap > 0; ap/=2, bp/=2) {
-			addRec(index + step*ap, axis+1, covered, box, value);
-			if (ap != bp) {
-				addRec(index + step*bp, axis+1, covered, box, value);
-			}
-		}
+		if (box[axis].empty()) return;
+		addAxis(index, axis, covered, box, value);
 	}
 
-	void assignItem(int index, const T& item) {
-		if (data[index].hasData[ALL_MASK]) return;
-		data[index].data = item;
-		data[index].hasData.set();
+	// The search continues on the next axis at the canonical nodes of the
+	// box, which are covered on this axis, and at the nodes above them.
+	void addAxis(Offset index, int axis, Mask covered, const Box<D>& box, const T& value) {
+		shape.forEachSlot(axis, box[axis], [&](int i, bool inside) {
+			addRec(index + slotOffset(axis, i), axis+1, inside ? covered | (1U << axis) : covered, box, value);
+			return false;
+		});
 	}
 
-	bool checkRec(int index, int axis, Mask covered, const Box<D>& box) const {
-		if (axis == D) {
-			const Item& x = data[index];
-//			std::cout<<"check "<<toIndex(index)<<' '<<covered<<' '<<x.hasData[covered ^ ALL_MASK]<<'\n';
-			return x.hasData[covered ^ ALL_MASK];
-		}
-		int s = size[axis];
-		int step = stepSize[axis];
-		Range range = box[axis];
-		if (range.size()==0) return false;
-		int a,b,ap,bp;
-		for(a=s+range.from, b=s+range.to-1, ap=a, bp=b; a<=b; a/=2, b/=2, ap/=2, bp/=2) {
-			if (a != ap && checkRec(index + step*ap, axis+1, covered, box)) return true;
-			if (b != bp && ap!=bp && checkRec(index + step*bp, axis+1, covered, box)) return true;
-			if ((a&1) && checkRec(index + step*a++, axis+1, covered | (1U << axis), box)) return true;
-			if (!(b&1) && checkRec(index + step*b--, axis+1, covered | (1U << axis), box)) return true;
-		}
-		for(; ap > 0; ap/=2, bp/=2) {
-			if (checkRec(index + step*ap, axis+1, covered, box)) return true;
-			if (ap != bp && checkRec(index + step*bp, axis+1, covered, box)) return true;
-		}
-		return false;
+	void assignItem(Offset index, const T& item) {
+		Flags& f = flags.ref(index);
+		if (has(f, ALL_MASK)) return;
+		items.ref(index) = item;
+		f = masks.subsets[ALL_MASK];
 	}
 
-	void genSubtreeState(Index index, Mask covered = 0) {
-		int totalIndex = computeIndex(index);
-		Item& t = data[totalIndex];
-		if (t.hasData[ALL_MASK]) {
+	FlagSearch<D, Layout, Storage<Flags>, Stats> search() const {
+		return {shape, flags, stats_};
+	}
+
+	void genSubtreeState(const Index& index) {
+		stats_.recompute();
+		Offset totalIndex = computeIndex(index);
+		Flags old = flags.get(totalIndex);
+		if (has(old, ALL_MASK)) {
 //			std::cout<<"skip postremove for node "<<index<<'\n';
 			return;
 		}
-		t.hasData.reset();
+		Flags f = 0;
 		for(int d=0; d<D; ++d) {
-			if (index[d] >= size[d]) continue;
-			if (1 & (covered >> d)) continue;
+			if (index[d] >= shape.size[d]) continue;
 			int x = index[d];
-			int step = stepSize[d];
-			int baseIndex = totalIndex - step*x;
-			const auto& a = data[baseIndex + step*(2*x)];
-			const auto& b = data[baseIndex + step*(2*x+1)];
-
-			std::bitset<1<<D> dirMask = 0;
-			for(Mask i=0; i<1<<D; ++i) if (!(1 & i>>d)) dirMask.set(i);
-			t.hasData = t.hasData | ((a.hasData | b.hasData) & dirMask);
+			Offset baseIndex = totalIndex - slotOffset(d, x);
+			Flags a = flags.get(baseIndex + slotOffset(d, 2*x));
+			Flags b = flags.get(baseIndex + slotOffset(d, 2*x+1));
+			f |= (a | b) & masks.dirs[d];
 		}
-//		std::cout<<"Postremove res for "<<index<<' '<<covered<<" : "<<t.hasData.to_ulong()<<'\n';
+//		std::cout<<"Postremove res for "<<index<<" : "<<(int)f<<'\n';
+		// Avoid allocating storage just to write an empty node.
+		if (f == old) return;
+		flags.ref(totalIndex) = f;
 	}
 
+	// Removes the items in the box below index on the axes from the given
+	// one. The children on every axis are handled before their parents, so
+	// the flags of a node can be recomputed from its children when the
+	// recursion leaves it. The nodes this does not reach, those outside the
+	// box on some axis, only change when propagateInSubtree moves items
+	// into them, and it recomputes them itself.
 	template<class V>
 	void removeInSubtree(Index index, int axis, const Box<D>& box, V&& visitor) {
-		int totalIndex = computeIndex(index);
-		Item& item = data[totalIndex];
-		if (!item.hasData[0]) return;
+		stats_.visit();
+		Offset totalIndex = computeIndex(index);
+		Flags f = flags.get(totalIndex);
+		if (!has(f, 0)) return;
 		if (axis == D) {
-			if (item.hasData[ALL_MASK]) {
-				visitor(index, item.data);
+			if (has(f, ALL_MASK)) {
+				stats_.visitor();
+				visitor(index, items.get(totalIndex));
+//				std::cout<<"Clear "<<index<<'\n';
+				flags.ref(totalIndex) = 0;
 			}
-//			std::cout<<"Clear "<<index<<'\n';
-			item.hasData.reset();
+			genSubtreeState(index);
 			return;
 		}
 		Range range = rangeForIndex(axis, index[axis]);
@@ -200,68 +452,127 @@ private:
 //			std::cout<<"splitting subtree "<<index<<' '<<axis<<'\n';
 			propagateInSubtree(index, axis+1, box, axis);
 		}
-		removeInSubtree(index, axis+1, box, visitor);
 		int i = index[axis];
-		if (i < size[axis]) {
+		if (i < shape.size[axis]) {
+			Offset baseIndex = totalIndex - slotOffset(axis, i);
+			flags.prefetch(baseIndex + slotOffset(axis, 2*i));
+			flags.prefetch(baseIndex + slotOffset(axis, 2*i+1));
+		}
+		if (i < shape.size[axis]) {
 			removeInSubtree(withIndex(index, axis, 2*i), axis, box, visitor);
 			removeInSubtree(withIndex(index, axis, 2*i+1), axis, box, visitor);
 		}
-		if (isParent) {
-//			std::cout<<"computing child data for "<<index<<' '<<axis<<'\n';
-			computeChildData(index, axis+1, box);
-		}
+		removeInSubtree(index, axis+1, box, visitor);
 //		std::cout<<" Exit remove "<<index<<' '<<axis<<'\n';
 	}
 
+	// Pushes the items of the nodes below index that lie exactly on its
+	// slot of splitAxis down to the two children of that slot, because the
+	// box covers only part of the slot. The child outside the box keeps its
+	// share, so its flags are recomputed here, after those of its children
+	// on the later axes. The other child is only marked as having items
+	// below, so that removeInSubtree descends into it and recomputes it.
 	void propagateInSubtree(Index index, int axis, const Box<D>& box, int splitAxis) {
 		if (axis == D) {
-			int totalIndex = computeIndex(index);
-			Item& t = data[totalIndex];
-			if (!t.hasData[0]) return;
+			stats_.visit();
+			Offset totalIndex = computeIndex(index);
+			if (!has(flags.get(totalIndex), 0)) return;
+			Flags& t = flags.ref(totalIndex);
 //			Mask covered = getCovered(index, box);
-			int step = stepSize[splitAxis];
 			int i = index[splitAxis];
-			int baseIndex = totalIndex - step * i;
-//			std::cout<<"   SPLIT "<<index<<" by "<<splitAxis<<' '<<t.hasData[ALL_MASK]<<'\n';
-			if (t.hasData[ALL_MASK]) {
-				assignItem(baseIndex + step * (2*i), t.data);
-				assignItem(baseIndex + step * (2*i+1), t.data);
-				t.hasData.reset(ALL_MASK);
-			} else if (t.hasData[1 << splitAxis]) {
-				Item& left = data[baseIndex + step * (2*i)];
-				Item& right = data[baseIndex + step * (2*i+1)];
-				left.hasData = left.hasData | t.hasData;
-				right.hasData = right.hasData | t.hasData;
+			Offset baseIndex = totalIndex - slotOffset(splitAxis, i);
+			Offset left = baseIndex + slotOffset(splitAxis, 2*i);
+			Offset right = baseIndex + slotOffset(splitAxis, 2*i+1);
+//			std::cout<<"   SPLIT "<<index<<" by "<<splitAxis<<' '<<has(t, ALL_MASK)<<'\n';
+			if (has(t, ALL_MASK)) {
+				const T& item = items.get(totalIndex);
+				assignItem(left, item);
+				assignItem(right, item);
+				t &= ~bit(ALL_MASK);
+				stats_.propagate();
+			} else if (has(t, 1 << splitAxis)) {
+				flags.ref(left) |= t;
+				flags.ref(right) |= t;
+				stats_.propagate();
+			}
+			for(int c=2*i; c<=2*i+1; ++c) {
+				if (!rangeForIndex(splitAxis, c).intersects(box[splitAxis])) {
+					genSubtreeState(withIndex(index, splitAxis, c));
+				}
 			}
 			return;
 		}
 		Range range = rangeForIndex(axis, index[axis]);
 		if (!range.intersects(box[axis])) return;
-		propagateInSubtree(index, axis+1, box, splitAxis);
 		int i = index[axis];
-		if (i < size[axis]) {
+		if (i < shape.size[axis]) {
 			propagateInSubtree(withIndex(index, axis, 2*i), axis, box, splitAxis);
 			propagateInSubtree(withIndex(index, axis, 2*i+1), axis, box, splitAxis);
 		}
+		propagateInSubtree(index, axis+1, box, splitAxis);
+	}
+
+	void canonicalSlots(int axis, int i, Range box, std::vector<int>& out) const {
+		Range range = rangeForIndex(axis, i);
+		if (!range.intersects(box)) return;
+		if (box.contains(range)) {
+			out.push_back(i);
+			return;
+		}
+		canonicalSlots(axis, 2*i, box, out);
+		canonicalSlots(axis, 2*i+1, box, out);
 	}
 
-	void computeChildData(Index index, int axis, const Box<D>& box) {
+	void assignProduct(const std::array<std::vector<int>, D>& slots, Index& index, int axis, const T& value) {
 		if (axis == D) {
-			Mask covered = 0;
-			for(int i=0; i<D; ++i) {
-				Range r = rangeForIndex(i, index[i]);
-				covered |= box[i].contains(r) << i;
-			}
-			return genSubtreeState(index, covered);
+			stats_.visit();
+			stats_.canonical();
+			assignItem(computeIndex(index), value);
+			changed.push_back(index);
+			return;
 		}
-//		Range range = rangeForIndex(axis, index[axis]);
-//		if (!range.intersects(box[axis])) return;
-		int i = index[axis];
-		if (i < size[axis]) {
-			computeChildData(withIndex(index, axis, 2*i), axis, box);
-			computeChildData(withIndex(index, axis, 2*i+1), axis, box);
+		for(int x: slots[axis]) {
+			index[axis] = x;
+			assignProduct(slots, index, axis+1, value);
+		}
+	}
+
+	// Recomputes the flags of all nodes in decreasing slot order, which
+	// handles the children before their parents on every axis.
+	void updateAll(Index& index, int axis) {
+		if (axis == D) {
+			genSubtreeState(index);
+			return;
+		}
+		for(index[axis] = 2*shape.size[axis]-1; index[axis] >= 1; --index[axis]) {
+			updateAll(index, axis+1);
+		}
+	}
+
+	// Recomputes the flags of the nodes in changed and of all nodes
+	// above them along any axes. The layouts put a child after its parent,
+	// so taking the largest offset first handles children before parents.
+	void updateChanged() {
+		std::vector<std::pair<Offset, Index>>& heap = closure;
+		heap.clear();
+		for(const Index& index: changed) heap.emplace_back(computeIndex(index), index);
+		std::make_heap(heap.begin(), heap.end());
+		Offset last = -1;
+		while(!heap.empty()) {
+			std::pop_heap(heap.begin(), heap.end());
+			Index index = heap.back().second;
+			Offset offset = heap.back().first;
+			heap.pop_back();
+			if (offset == last) continue;
+			last = offset;
+			genSubtreeState(index);
+			for(int d=0; d<D; ++d) {
+				if (index[d] == 1) continue;
+				Index parent = withIndex(index, d, index[d]/2);
+				heap.emplace_back(offset - slotOffset(d, index[d]) + slotOffset(d, parent[d]), parent);
+				std::push_heap(heap.begin(), heap.end());
+			}
 		}
-		computeChildData(withIndex(index, axis, i), axis+1, box);
 	}
 
 	static Index withIndex(Index index, int axis, int x) {
@@ -269,15 +580,25 @@ private:
 		return index;
 	}
 
-	int computeIndex(const Index& index) const {
-		int r=0;
-		for(int i=0; i<D; ++i) r += stepSize[i] * index[i];
-		return r;
+	Offset computeIndex(const Index& index) const {
+		return shape.computeIndex(index);
+	}
+
+	Offset slotOffset(int axis, int slot) const {
+		return shape.slotOffset(axis, slot);
 	}
 
 	static constexpr Mask ALL_MASK = (1U<<D)-1;
+	static constexpr MaskTables<D> masks{};
 
-	Index size = {};
-	Index stepSize = {};
-	std::vector<Item> data;
+	TreeShape<D, Layout> shape;
+	Storage<Flags> flags;
+	Storage<T> items;
+	mutable Stats stats_;
+	// Scratch space of build.
+	std::vector<Index> changed;
+	std::vector<std::pair<Offset, Index>> closure;
 };
+
+template<class T, int D, template<class> class Storage, class Layout, class Stats>
+constexpr MaskTables<D> UnifiedTree<T, D, Storage, Layout, Stats>::masks;
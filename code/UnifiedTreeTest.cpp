@@ -2,6 +2,7 @@
 
 #include <bitset>
 #include <random>
+#include <thread>
 #include <vector>
 
 #include <gmock/gmock-more-matchers.h>
@@ -118,8 +119,8 @@ ostream& operator<<(ostream& out, const Operation<D>& op) {
 	return out<<"{"<<(int)op.type<<' '<<op.box<<"}";
 }
 
-template<int D>
-void runOps(UnifiedTree<Item<D>, D>& actual, const vector<Operation<D>>& ops) {
+template<int D, template<class> class S, class L, class St>
+void runOps(UnifiedTree<Item<D>, D, S, L, St>& actual, const vector<Operation<D>>& ops) {
 	SlowTree<Item<D>, D> expected(actual.getSize());
 	ostringstream oss;
 	for(const auto& t: ops) {
@@ -142,13 +143,13 @@ void runOps(UnifiedTree<Item<D>, D>& actual, const vector<Operation<D>>& ops) {
 }
 
 template<int D>
-vector<Operation<D>> genRandomOps(int size, int n, vector<OType> otypes, mt19937& rng) {
+vector<Operation<D>> genRandomOps(array<int, D> sizes, int n, vector<OType> otypes, mt19937& rng) {
 	vector<Operation<D>> ops;
 	for(int i=0; i<n; ++i) {
 		Operation<D> op;
 		op.type = otypes[rng()%otypes.size()];
 		for(int j=0; j<D; ++j) {
-			int a = rng()%(size+1), b = rng()%(size+1);
+			int a = rng()%(sizes[j]+1), b = rng()%(sizes[j]+1);
 			if (a>b) swap(a,b);
 			op.box[j] = {a,b};
 		}
@@ -157,6 +158,20 @@ vector<Operation<D>> genRandomOps(int size, int n, vector<OType> otypes, mt19937
 	return ops;
 }
 
+template<int D>
+Box<D> boxForAll(const array<int, D>& sizes) {
+	Box<D> box;
+	for(int j=0; j<D; ++j) box[j] = {0, sizes[j]};
+	return box;
+}
+
+template<int D>
+vector<Operation<D>> genRandomOps(int size, int n, vector<OType> otypes, mt19937& rng) {
+	array<int, D> sizes;
+	sizes.fill(size);
+	return genRandomOps<D>(sizes, n, otypes, rng);
+}
+
 TEST(UnifiedTreeTest1D, AddCheckUnitTree) {
 	UnifiedTree<Item<1>, 1> tree{{1}};
 	vector<Operation<1>> ops = {
@@ -238,6 +253,16 @@ TEST(UnifiedTreeTest1D, RandomAddRemove32) {
 	}
 }
 
+TEST(UnifiedTreeTest1D, RandomAddRemoveNonPow2) {
+	for(int size=1; size<=40; ++size) {
+		for(int i=0; i<100; ++i) {
+			UnifiedTree<Item<1>, 1> tree{{size}};
+			mt19937 rng(i);
+			runOps(tree, genRandomOps<1>(size, 6, {OType::ADD, OType::REMOVE, OType::CHECK}, rng));
+		}
+	}
+}
+
 TEST(UnifiedTreeTest2D, AddCheckUnitTree) {
 	UnifiedTree<Item<2>, 2> tree{{1, 1}};
 	vector<Operation<2>> ops = {
@@ -310,6 +335,113 @@ TEST(UnifiedTreeTest2D, RandomAddRemove32) {
 	}
 }
 
+TEST(UnifiedTreeTest2D, RandomAddRemoveNonPow2) {
+	mt19937 sizeRng(1);
+	for(int i=0; i<1000; ++i) {
+		array<int, 2> sizes = {{1 + (int)(sizeRng()%33), 1 + (int)(sizeRng()%33)}};
+		UnifiedTree<Item<2>, 2> tree{sizes};
+		mt19937 rng(i);
+		runOps(tree, genRandomOps<2>(sizes, 10, {OType::ADD, OType::REMOVE, OType::CHECK}, rng));
+	}
+}
+
+// Random boxes rarely notice a single wrong cell, so this checks every cell.
+TEST(UnifiedTreeTest2D, RandomAddRemoveCells) {
+	mt19937 sizeRng(2);
+	for(int i=0; i<1000; ++i) {
+		array<int, 2> sizes = {{1 + (int)(sizeRng()%17), 1 + (int)(sizeRng()%17)}};
+		UnifiedTree<Item<2>, 2> tree{sizes};
+		mt19937 rng(i);
+		auto ops = genRandomOps<2>(sizes, 8, {OType::ADD, OType::REMOVE}, rng);
+		for(int x=0; x<sizes[0]; ++x) {
+			for(int y=0; y<sizes[1]; ++y) ops.push_back(makeOp2(OType::CHECK, {x, x+1}, {y, y+1}));
+		}
+		runOps(tree, ops);
+	}
+}
+
+TEST(UnifiedTreeTest2D, BlockedRandomAddRemoveCells) {
+	mt19937 sizeRng(3);
+	for(int i=0; i<300; ++i) {
+		array<int, 2> sizes = {{1 + (int)(sizeRng()%80), 1 + (int)(sizeRng()%80)}};
+		UnifiedTree<Item<2>, 2, DenseStorage, BlockedLayout> tree{sizes};
+		mt19937 rng(i);
+		auto ops = genRandomOps<2>(sizes, 8, {OType::ADD, OType::REMOVE}, rng);
+		for(int x=0; x<sizes[0]; ++x) {
+			for(int y=0; y<sizes[1]; ++y) ops.push_back(makeOp2(OType::CHECK, {x, x+1}, {y, y+1}));
+		}
+		runOps(tree, ops);
+	}
+}
+
+TEST(UnifiedTreeTest2D, ClearAndReuse) {
+	constexpr int size = 32;
+	UnifiedTree<Item<2>, 2> tree{{size, size}};
+	for(int i=0; i<100; ++i) {
+		mt19937 rng(i);
+		tree.clear();
+		runOps(tree, genRandomOps<2>(size, 10, {OType::ADD, OType::REMOVE, OType::CHECK}, rng));
+	}
+}
+
+TEST(UnifiedTreeTest2D, PagedRandomAddRemove32) {
+	constexpr int size = 32;
+	for(int i=0; i<1000; ++i) {
+		UnifiedTree<Item<2>, 2, PagedStorage> tree{{size, size}};
+		mt19937 rng(i);
+		runOps(tree, genRandomOps<2>(size, 10, {OType::ADD, OType::REMOVE, OType::CHECK}, rng));
+	}
+}
+
+TEST(UnifiedTreeTest2D, PagedClearAndReuse) {
+	constexpr int size = 32;
+	UnifiedTree<Item<2>, 2, PagedStorage> tree{{size, size}};
+	for(int i=0; i<100; ++i) {
+		mt19937 rng(i);
+		tree.clear();
+		EXPECT_EQ(tree.flagStorage().pages(), 0);
+		runOps(tree, genRandomOps<2>(size, 10, {OType::ADD, OType::REMOVE, OType::CHECK}, rng));
+	}
+}
+
+// A dense tree of this size would need 2^30 nodes. The operations stay in a
+// small corner and must give the same results as in a small dense tree.
+TEST(UnifiedTreeTest2D, PagedLargeSparse) {
+	constexpr int size = 32;
+	constexpr int large = 1<<14;
+	const int offset = large - size;
+	for(int i=0; i<100; ++i) {
+		UnifiedTree<Item<2>, 2> small{{size, size}};
+		UnifiedTree<Item<2>, 2, PagedStorage> tree{{large, large}};
+		mt19937 rng(i);
+		for(auto op: genRandomOps<2>(size, 20, {OType::ADD, OType::REMOVE, OType::CHECK}, rng)) {
+			Box<2> shifted = op.box;
+			for(int d=0; d<2; ++d) shifted[d] = {op.box[d].from+offset, op.box[d].to+offset};
+			switch(op.type) {
+				case OType::ADD:
+					small.add(op.box, op.value);
+					tree.add(shifted, op.value);
+					break;
+				case OType::REMOVE:
+					small.remove(op.box);
+					tree.remove(shifted);
+					break;
+				case OType::CHECK:
+					EXPECT_EQ(tree.check(shifted), small.check(op.box))<<i<<' '<<op;
+					break;
+			}
+		}
+		EXPECT_LT(tree.flagStorage().pages(), 1000);
+		FrozenTree<2> frozen = tree.freeze();
+		EXPECT_LE(frozen.flagStorage().pages(), tree.flagStorage().pages());
+		for(auto op: genRandomOps<2>(size, 20, {OType::CHECK}, rng)) {
+			Box<2> shifted = op.box;
+			for(int d=0; d<2; ++d) shifted[d] = {op.box[d].from+offset, op.box[d].to+offset};
+			EXPECT_EQ(frozen.check(shifted), small.check(op.box))<<i<<' '<<op;
+		}
+	}
+}
+
 TEST(UnifiedTreeTest3D, RandomAddRemove32) {
 	constexpr int size = 32;
 	for(int i=0; i<10; ++i) {
@@ -320,4 +452,185 @@ TEST(UnifiedTreeTest3D, RandomAddRemove32) {
 	}
 }
 
+TEST(UnifiedTreeTest3D, PagedRandomAddRemove32) {
+	constexpr int size = 32;
+	for(int i=0; i<10; ++i) {
+		UnifiedTree<Item<3>, 3, PagedStorage> tree{{size, size, size}};
+		mt19937 rng(i);
+		runOps(tree, genRandomOps<3>(size, 10, {OType::ADD, OType::REMOVE, OType::CHECK}, rng));
+	}
+}
+
+TEST(UnifiedTreeTest3D, RandomAddRemoveNonPow2) {
+	for(int i=0; i<100; ++i) {
+		UnifiedTree<Item<3>, 3> tree{{17, 5, 11}};
+		mt19937 rng(i);
+		runOps(tree, genRandomOps<3>({{17, 5, 11}}, 10, {OType::ADD, OType::REMOVE, OType::CHECK}, rng));
+	}
+}
+
+TEST(UnifiedTreeTest3D, BlockedRandomAddRemove) {
+	for(int i=0; i<100; ++i) {
+		UnifiedTree<Item<3>, 3, PagedStorage, BlockedLayout> tree{{70, 5, 130}};
+		mt19937 rng(i);
+		runOps(tree, genRandomOps<3>({{70, 5, 130}}, 10, {OType::ADD, OType::REMOVE, OType::CHECK}, rng));
+	}
+}
+
+template<int D>
+void checkBatches(const array<int, D>& sizes, int runs) {
+	for(int i=0; i<runs; ++i) {
+		UnifiedTree<Item<D>, D> tree{sizes};
+		mt19937 rng(i);
+		for(const auto& op: genRandomOps<D>(sizes, 10, {OType::ADD, OType::REMOVE}, rng)) {
+			if (op.type == OType::ADD) tree.add(op.box, op.value);
+			else tree.remove(op.box);
+		}
+		vector<Box<D>> boxes;
+		for(const auto& op: genRandomOps<D>(sizes, 1 + rng()%50, {OType::CHECK}, rng)) {
+			boxes.push_back(op.box);
+		}
+		vector<bool> found;
+		tree.checkBatch(boxes, found);
+		ASSERT_EQ(found.size(), boxes.size());
+		for(size_t k=0; k<boxes.size(); ++k) {
+			EXPECT_EQ(found[k], tree.check(boxes[k]))<<i<<' '<<boxes[k];
+		}
+	}
+}
+
+TEST(UnifiedTreeTest2D, CheckBatch) {
+	checkBatches<2>({{23, 32}}, 300);
+}
+
+TEST(UnifiedTreeTest3D, CheckBatch) {
+	checkBatches<3>({{9, 16, 13}}, 300);
+}
+
+// Builds a tree from a few or many boxes, which takes the two ways of fixing
+// the flags, and compares it with adding the boxes one by one.
+template<int D>
+void buildTrees(const array<int, D>& sizes, int boxCount, int runs) {
+	for(int i=0; i<runs; ++i) {
+		mt19937 rng(i);
+		UnifiedTree<Item<D>, D> added{sizes};
+		UnifiedTree<Item<D>, D> built{sizes};
+		vector<pair<Box<D>, Item<D>>> boxes;
+		for(const auto& op: genRandomOps<D>(sizes, 1 + rng()%boxCount, {OType::ADD}, rng)) {
+			boxes.push_back({op.box, op.value});
+			added.add(op.box, op.value);
+		}
+		built.build(boxes);
+		auto ops = genRandomOps<D>(sizes, 20, {OType::REMOVE, OType::CHECK}, rng);
+		for(const auto& op: ops) {
+			if (op.type == OType::REMOVE) {
+				added.remove(op.box);
+				built.remove(op.box);
+			} else {
+				EXPECT_EQ(built.check(op.box), added.check(op.box))<<i<<' '<<op;
+			}
+		}
+	}
+}
+
+TEST(UnifiedTreeTest2D, BuildFew) {
+	buildTrees<2>({{30, 17}}, 3, 300);
+}
+
+TEST(UnifiedTreeTest2D, BuildMany) {
+	buildTrees<2>({{30, 17}}, 200, 100);
+}
+
+TEST(UnifiedTreeTest3D, BuildMany) {
+	buildTrees<3>({{7, 12, 5}}, 100, 100);
+}
+
+// Checks a frozen copy from several threads at once and compares the
+// answers with the tree it was made from, which then changes.
+template<int D, template<class> class S, class L>
+void checkFrozen(const array<int, D>& sizes, int runs) {
+	for(int i=0; i<runs; ++i) {
+		UnifiedTree<Item<D>, D, S, L> tree{sizes};
+		mt19937 rng(i);
+		for(const auto& op: genRandomOps<D>(sizes, 10, {OType::ADD, OType::REMOVE}, rng)) {
+			if (op.type == OType::ADD) tree.add(op.box, op.value);
+			else tree.remove(op.box);
+		}
+		FrozenTree<D, L> frozen = tree.freeze();
+		vector<Box<D>> boxes;
+		for(const auto& op: genRandomOps<D>(sizes, 200, {OType::CHECK}, rng)) {
+			boxes.push_back(op.box);
+		}
+		vector<bool> expected;
+		for(const Box<D>& box: boxes) expected.push_back(tree.check(box));
+		tree.add(boxForAll<D>(sizes), {});
+
+		constexpr int threadCount = 4;
+		vector<vector<bool>> single(threadCount), batched(threadCount);
+		vector<thread> threads;
+		for(int t=0; t<threadCount; ++t) {
+			threads.emplace_back([&, t]() {
+				for(const Box<D>& box: boxes) single[t].push_back(frozen.check(box));
+				frozen.checkBatch(boxes, batched[t]);
+			});
+		}
+		for(thread& t: threads) t.join();
+		for(int t=0; t<threadCount; ++t) {
+			EXPECT_EQ(single[t], expected)<<i;
+			EXPECT_EQ(batched[t], expected)<<i;
+		}
+	}
+}
+
+TEST(UnifiedTreeTest2D, Frozen) {
+	checkFrozen<2, DenseStorage, HeapLayout>({{23, 32}}, 20);
+}
+
+TEST(UnifiedTreeTest3D, FrozenPagedBlocked) {
+	checkFrozen<3, PagedStorage, BlockedLayout>({{9, 70, 13}}, 10);
+}
+
+TEST(UnifiedTreeTest2D, Stats) {
+	UnifiedTree<Item<2>, 2, DenseStorage, HeapLayout, CountingStats> tree{{8, 8}};
+	tree.add(box2({0, 8}, {0, 8}), {});
+	EXPECT_EQ(tree.stats().last().calls, 1);
+	EXPECT_EQ(tree.stats().last().canonicalHits, 1);
+	EXPECT_EQ(tree.stats().last().nodeVisits, 1);
+
+	// The canonical nodes of [2,6) are [2,4) and [4,6), below [0,4), [4,8)
+	// and the root.
+	tree.add(box2({2, 6}, {0, 8}), {});
+	EXPECT_EQ(tree.stats().last().canonicalHits, 2);
+	EXPECT_EQ(tree.stats().last().nodeVisits, 5);
+
+	EXPECT_TRUE(tree.check(box2({3, 4}, {3, 4})));
+	EXPECT_GT(tree.stats().last().nodeVisits, 0);
+
+	int visited = 0;
+	tree.remove(box2({0, 4}, {0, 8}), [&](const array<int, 2>&, const Item<2>&) { ++visited; });
+	const TreeOpStats& removed = tree.stats().last();
+	EXPECT_EQ(removed.visitorCalls, visited);
+	EXPECT_GT(removed.propagations, 0);
+	EXPECT_GT(removed.recomputes, 0);
+	EXPECT_FALSE(tree.check(box2({0, 4}, {0, 8})));
+	EXPECT_TRUE(tree.check(box2({4, 5}, {0, 8})));
+
+	EXPECT_EQ(tree.stats().total(TreeOp::ADD).calls, 2);
+	EXPECT_EQ(tree.stats().total(TreeOp::ADD).canonicalHits, 3);
+	EXPECT_EQ(tree.stats().total(TreeOp::CHECK).calls, 3);
+	EXPECT_EQ(tree.stats().total(TreeOp::REMOVE).calls, 1);
+	tree.resetStats();
+	EXPECT_EQ(tree.stats().total(TreeOp::ADD).calls, 0);
+}
+
+// Needs 16 flag bits per node.
+TEST(UnifiedTreeTest4D, RandomAddRemove8) {
+	constexpr int size = 8;
+	for(int i=0; i<100; ++i) {
+		UnifiedTree<Item<4>, 4> tree{{size, size, size, size}};
+		mt19937 rng(i);
+		runOps(tree, genRandomOps<4>(size, 10, {OType::ADD, OType::REMOVE, OType::CHECK}, rng));
+	}
+}
+
 } // namespace
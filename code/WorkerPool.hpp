@@ -0,0 +1,75 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads that is reused for many parallel steps, so that the
+// threads are not created and joined again for every step.
+class WorkerPool {
+public:
+	// Keeps threads-1 threads, the caller of run is the remaining one.
+	explicit WorkerPool(int threads) {
+		for(int i=1; i<threads; ++i) {
+			workers.emplace_back([this, i]() { work(i); });
+		}
+	}
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	~WorkerPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		started.notify_all();
+		for(std::thread& t: workers) t.join();
+	}
+
+	int size() const { return (int)workers.size() + 1; }
+
+	// Calls job(i) for every i in [0, size()) on its own thread and returns
+	// when all calls have returned. The calling thread runs job(0).
+	void run(const std::function<void(int)>& job) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			current = &job;
+			pending = (int)workers.size();
+			++generation;
+		}
+		started.notify_all();
+		job(0);
+		std::unique_lock<std::mutex> lock(mutex);
+		finished.wait(lock, [this]() { return pending == 0; });
+		current = nullptr;
+	}
+
+private:
+	void work(int i) {
+		unsigned seen = 0;
+		while(true) {
+			const std::function<void(int)>* job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				started.wait(lock, [&]() { return stopping || generation != seen; });
+				if (stopping) return;
+				seen = generation;
+				job = current;
+			}
+			(*job)(i);
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--pending == 0) finished.notify_one();
+		}
+	}
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable started;
+	std::condition_variable finished;
+	const std::function<void(int)>* current = nullptr;
+	unsigned generation = 0;
+	int pending = 0;
+	bool stopping = false;
+};
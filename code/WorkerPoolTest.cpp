@@ -0,0 +1,44 @@
+#include "WorkerPool.hpp"
+#include <atomic>
+#include <set>
+#include <gtest/gtest.h>
+
+namespace {
+
+using namespace std;
+
+TEST(WorkerPoolTest, RunsEveryIndexOnce) {
+	WorkerPool pool(4);
+	EXPECT_EQ(pool.size(), 4);
+	vector<int> counts(4);
+	pool.run([&](int i) { ++counts[i]; });
+	EXPECT_EQ(counts, vector<int>(4, 1));
+}
+
+TEST(WorkerPoolTest, ReusesThreadsAcrossRuns) {
+	WorkerPool pool(3);
+	set<thread::id> ids;
+	mutex idMutex;
+	atomic<int> total{0};
+	for(int run=0; run<200; ++run) {
+		pool.run([&](int i) {
+			total += i+1;
+			lock_guard<mutex> lock(idMutex);
+			ids.insert(this_thread::get_id());
+		});
+	}
+	EXPECT_EQ(total, 200*6);
+	EXPECT_EQ(ids.size(), 3u);
+}
+
+TEST(WorkerPoolTest, SingleThreadRunsOnCaller) {
+	WorkerPool pool(1);
+	thread::id id;
+	pool.run([&](int i) {
+		EXPECT_EQ(i, 0);
+		id = this_thread::get_id();
+	});
+	EXPECT_EQ(id, this_thread::get_id());
+}
+
+}
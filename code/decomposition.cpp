@@ -2,15 +2,19 @@
 
 #include "Box.hpp"
 #include "Span.hpp"
+#include "Trace.hpp"
+#include "WorkerPool.hpp"
 #include "overlap.hpp"
 #include "util.hpp"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
-#include <iostream>
 #include <numeric>
 #include <map>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
 using namespace std;
@@ -30,7 +34,6 @@ struct Event {
 
 constexpr int X_AXIS = 0;
 constexpr int Y_AXIS = 1;
-constexpr int Z_AXIS = 2;
 
 constexpr int UP = 2;
 constexpr int DOWN = 3;
@@ -48,7 +51,7 @@ struct DecomposeNode {
 		if (obstacle >= 0) {
 			res.obstacles[DOWN].push_back(obstacle);
 		}
-		cout<<"Creating cell "<<res.box<<' '<<res.links[UP]<<'\n';
+		Trace::event(TraceType::CREATE_CELL, -1, yEnd, res.box);
 		return res;
 	}
 
@@ -76,6 +79,12 @@ void moveContentsUnordered(vector<T>& to, vector<T>& from) {
 class Sweepline {
 public:
 	Sweepline(const ObstacleSet<2>* obstacles): obstacles(*obstacles) {}
+	// Continues a sweep that has handled the events up to y and has the
+	// given free ranges there. Their cells below y are not produced.
+	Sweepline(const ObstacleSet<2>* obstacles, const vector<Range>& freeRanges, int y):
+		obstacles(*obstacles) {
+		for(Range r: freeRanges) nodeSet.insert(DecomposeNode{r, y, {}, {}});
+	}
 
 	void handleEvent(const Event& event) {
 		if (event.startObstacle) {
@@ -140,7 +149,7 @@ private:
 			it = nodeSet.erase(it);
 		}
 		DecomposeNode node{totalRange, event.pos, move(links), move(obstacles)};
-		cout<<"insert to nodeset "<<totalRange<<' '<<event.idx<<'\n';
+		Trace::event(TraceType::INSERT_NODE, event.idx, event.pos, Box<1>{{totalRange}});
 		nodeSet.insert(std::move(node));
 	}
 
@@ -193,12 +202,12 @@ void addXObstacles(Decomposition<2>& decomposition,
 } // namespace
 
 template<>
-Decomposition<2> decomposeFreeSpace<2>(const ObstacleSet<2>& obstacles) {
+Decomposition<2> decomposeFreeSpace<2>(const ObstacleSet<2>& obstacles, int, SweepMode) {
 	vector<Event> events;
 	map<pair<int,int>, int> cornerToObstacle;
 	for(int i=0; i<(int)obstacles.size(); ++i) {
 		const auto& obs = obstacles[i];
-		cout<<"obs "<<obs<<' '<<obs.box[X_AXIS].size()<<'\n';
+		Trace::event(TraceType::INPUT_OBSTACLE, i, obs.direction, obs.box);
 		if (obs.box[X_AXIS].size() == 0) {
 			cornerToObstacle[{obs.box[X_AXIS].from, obs.box[Y_AXIS].from}] = i;
 			cornerToObstacle[{obs.box[X_AXIS].to, obs.box[Y_AXIS].from}] = i;
@@ -220,6 +229,91 @@ Decomposition<2> decomposeFreeSpace<2>(const ObstacleSet<2>& obstacles) {
 	return decomposition;
 }
 
+namespace {
+
+// Whether the closed boxes have a point in common.
+template<int D>
+bool touches(const Box<D>& a, const Box<D>& b) {
+	for(int i=0; i<D; ++i) {
+		if (a[i].to < b[i].from || b[i].to < a[i].from) return false;
+	}
+	return true;
+}
+
+// Whether the closed box lies inside the open window.
+template<int D>
+bool strictlyInside(const Box<D>& box, const Box<D>& window) {
+	for(int i=0; i<D; ++i) {
+		if (box[i].from <= window[i].from || box[i].to >= window[i].to) return false;
+	}
+	return true;
+}
+
+// The boxes of the cells of the free space that lie strictly inside the
+// window. The sweep only looks at the obstacles in the window, so the
+// cells that touch its border are cut off by it and are left out. cells
+// is the decomposition of the plane before the obstacles inside the window
+// changed.
+//
+// This cuts the plane only on the first axis: the sweeps along the other
+// axes start at the border of the plane and need all of their events.
+template<int P>
+vector<Box<P>> decomposeWindow(const ObstacleSet<P>& obstacles, const Box<P>& window,
+		const vector<pair<Box<P>, int>>&) {
+	const Range xr = window[X_AXIS];
+	ObstacleSet<P> part;
+	for(const Obstacle<P>& obs: obstacles) {
+		Range r = obs.box[X_AXIS];
+		if (r.empty() ? r.from <= xr.from || r.from >= xr.to : !r.intersects(xr)) continue;
+		part.push_back(obs);
+		if (!r.empty()) part.back().box[X_AXIS] = r.intersection(xr);
+	}
+	vector<Box<P>> boxes;
+	for(const Cell<P>& cell: decomposeFreeSpace(part)) {
+		if (strictlyInside(cell.box, window)) boxes.push_back(cell.box);
+	}
+	return boxes;
+}
+
+// In the plane the window is cut on both axes. The sweep starts at the
+// bottom of the window, where the free ranges are those of the cells that
+// reach across it: the obstacles only changed above it.
+template<>
+vector<Box<2>> decomposeWindow<2>(const ObstacleSet<2>& obstacles, const Box<2>& window,
+		const vector<pair<Box<2>, int>>& cells) {
+	const Range xr = window[X_AXIS], yr = window[Y_AXIS];
+	vector<Range> freeRanges;
+	for(const auto& cell: cells) {
+		const Box<2>& box = cell.first;
+		if (box[Y_AXIS].contains(yr.from) && box[X_AXIS].intersects(xr)) {
+			freeRanges.push_back(box[X_AXIS].intersection(xr));
+		}
+	}
+	ObstacleSet<2> part;
+	vector<Event> events;
+	for(const Obstacle<2>& obs: obstacles) {
+		int y = obs.box[Y_AXIS].from;
+		if (!obs.box[Y_AXIS].empty() || y <= yr.from || y >= yr.to) continue;
+		if (!obs.box[X_AXIS].intersects(xr)) continue;
+		events.push_back({y, (int)part.size(), obs.direction == UP});
+		part.push_back(obs);
+		part.back().box[X_AXIS] = obs.box[X_AXIS].intersection(xr);
+	}
+	sort(events.begin(), events.end());
+
+	Sweepline sweepline(&part, freeRanges, yr.from);
+	for(Event event: events) {
+		sweepline.handleEvent(event);
+	}
+	vector<Box<2>> boxes;
+	for(const Cell<2>& cell: sweepline.result()) {
+		if (strictlyInside(cell.box, window)) boxes.push_back(cell.box);
+	}
+	return boxes;
+}
+
+} // namespace
+
 //namespace {
 
 template<int A, int B>
@@ -247,22 +341,198 @@ struct IndexedBoxes {
 template<int D>
 class SweepState {
 public:
-	SweepState(ObstacleSet<D> obstacles): obstacles(obstacles) {}
+	SweepState(ObstacleSet<D> obstacles): obstacles(obstacles) {
+		for(int i=0; i<(int)this->obstacles.size(); ++i) {
+			Range r = this->obstacles[i].box[D-1];
+			if (r.empty()) continue;
+			events.push_back({r.from, i, true});
+			events.push_back({r.to, i, false});
+		}
+		sort(events.begin(), events.end());
+	}
 
-	void advanceToDepth(int z) {
-		ObstacleSet<D-1> crossSection;
+	// The obstacles at one depth and the decomposition of their cross
+	// section.
+	struct CrossSection {
+		int z = -1;
 		vector<int> obsIndex;
-		for(size_t i=0; i<obstacles.size(); ++i) {
+		// The obstacles that start and end at z.
+		vector<int> added, removed;
+		Decomposition<D-1> plane;
+
+		void decompose(const ObstacleSet<D>& obstacles) {
+			ObstacleSet<D-1> crossSection;
+			crossSection.reserve(obsIndex.size());
+			for(int i: obsIndex) {
+				crossSection.push_back({obstacles[i].box.project(), obstacles[i].direction});
+			}
+			plane = decomposeFreeSpace(crossSection);
+		}
+	};
+
+	// The depths must be increasing.
+	void advanceToDepth(int z) {
+		CrossSection section;
+		nextCrossSection(z, section);
+		section.decompose(obstacles);
+		mergeCrossSection(section);
+	}
+
+	// Same as advanceToDepth for each of the depths. The cross sections are
+	// decomposed on the given number of threads in batches, and each batch
+	// is merged in order once it is done. The threads are kept for all
+	// batches.
+	void advanceToDepths(const vector<int>& depths, int threads) {
+		const size_t batchSize = 16*threads;
+		WorkerPool workers(threads);
+		vector<CrossSection> batch;
+		size_t i = 0;
+		while(i < depths.size()) {
+			batch.clear();
+			for(; i < depths.size() && batch.size() < batchSize; ++i) {
+				batch.emplace_back();
+				nextCrossSection(depths[i], batch.back());
+			}
+			atomic<size_t> next(0);
+			workers.run([&](int) {
+				for(size_t k; (k = next++) < batch.size(); ) batch[k].decompose(obstacles);
+			});
+			for(CrossSection& section: batch) mergeCrossSection(section);
+		}
+	}
+
+	// Same as advanceToDepth, but only decomposes the part of the cross
+	// section around the obstacles that changed since the previous depth,
+	// and replaces the cells there. The new cells are linked to their
+	// neighbours in the cross section, and the cells get the obstacles
+	// that start next to them.
+	void updateToDepth(int z) {
+		CrossSection section;
+		nextCrossSection(z, section);
+		vector<int> added;
+		vector<Box<D-1>> changed = changedBoxes(section);
+		if (!changed.empty()) {
+			added = replaceCells(section, changed, z);
+		}
+		for(int i: section.removed) {
+			const Obstacle<D>& obs = obstacles[i];
+			eraseValue(sideObstacles[obs.direction][obs.box[obs.direction/2].from], i);
+		}
+		for(int i: section.added) {
+			const Obstacle<D>& obs = obstacles[i];
+			sideObstacles[obs.direction][obs.box[obs.direction/2].from].push_back(i);
+		}
+		for(int i: added) {
+			Cell<D>& cell = decomposition[i];
+			for(int d=0; d<2*(D-1); ++d) {
+				int side = cell.box[d/2][d&1];
+				for(int j: sideCells[d^1][side]) {
+					if (!overlapsBeside(cell.box, decomposition[j].box, d/2)) continue;
+					cell.links[d].push_back(j);
+					decomposition[j].links[d^1].push_back(i);
+				}
+				for(int j: sideObstacles[d^1][side]) {
+					if (overlapsBeside(cell.box, obstacles[j].box, d/2)) cell.obstacles[d].push_back(j);
+				}
+			}
+		}
+		for(int i: section.added) {
 			const Obstacle<D>& obs = obstacles[i];
-			if (obs.box[Z_AXIS].contains(z)) {
-				crossSection.push_back({obs.box.project(), obs.direction});
-				obsIndex.push_back(i);
+			int d = obs.direction^1;
+			for(int j: sideCells[d][obs.box[d/2].from]) {
+				if (overlapsBeside(decomposition[j].box, obs.box, d/2)) {
+					decomposition[j].obstacles[d].push_back(i);
+				}
 			}
 		}
-		Decomposition<D-1> curPlane = decomposeFreeSpace(crossSection);
+	}
+
+	Decomposition<D>& result() { return decomposition; }
+
+private:
+	// Decomposes a window around the changed obstacles and replaces the
+	// cells in it. Returns the indices of the new cells.
+	vector<int> replaceCells(const CrossSection& section, const vector<Box<D-1>>& changed, int z) {
+		// The cells that touch a changed obstacle are the ones that can
+		// change, and the new cells there only cover them and the changed
+		// obstacles. The window is a box around all of them.
+		Box<D-1> changedBox = changed[0];
+		for(const Box<D-1>& box: changed) changedBox = boxUnion(changedBox, box);
+		Box<D-1> window = changedBox;
+		for(const auto& cell: activeIndex) {
+			if (touches(cell.first, changedBox)) window = boxUnion(window, cell.first);
+		}
+		for(int i=0; i<D-1; ++i) window[i] = {window[i].from-1, window[i].to+1};
+
+		ObstacleSet<D-1> crossSection;
+		crossSection.reserve(section.obsIndex.size());
+		for(int i: section.obsIndex) {
+			crossSection.push_back({obstacles[i].box.project(), obstacles[i].direction});
+		}
+		vector<Box<D-1>> boxes = decomposeWindow(crossSection, window, activeIndex);
+		sort(boxes.begin(), boxes.end());
+
+		// The cells strictly inside the window are replaced by the new ones,
+		// except for those that are there again.
+		vector<pair<Box<D-1>, int>> newActive;
+		newActive.reserve(activeIndex.size() + boxes.size());
+		vector<int> added;
+		auto addCell = [&](const Box<D-1>& box) {
+			int i = decomposition.size();
+			decomposition.emplace_back(fromProj(box, z));
+			for(int d=0; d<2*(D-1); ++d) sideCells[d][box[d/2][d&1]].push_back(i);
+			newActive.emplace_back(box, i);
+			added.push_back(i);
+		};
+		size_t k = 0;
+		for(const auto& cell: activeIndex) {
+			for(; k < boxes.size() && boxes[k] < cell.first; ++k) addCell(boxes[k]);
+			if (k < boxes.size() && !(cell.first < boxes[k])) {
+				newActive.push_back(cell);
+				++k;
+			} else if (strictlyInside(cell.first, window)) {
+				decomposition[cell.second].box[D-1].to = z;
+				for(int d=0; d<2*(D-1); ++d) eraseValue(sideCells[d][cell.first[d/2][d&1]], cell.second);
+			} else {
+				newActive.push_back(cell);
+			}
+		}
+		for(; k < boxes.size(); ++k) addCell(boxes[k]);
+		activeIndex = move(newActive);
+		return added;
+	}
+
+	// Finds the obstacles whose range contains z by merging the events up
+	// to z into the ones of the previous depth.
+	void nextCrossSection(int z, CrossSection& section) {
+		vector<int> added, removed;
+		for(; nextEvent < events.size() && events[nextEvent].pos <= z; ++nextEvent) {
+			const Event& e = events[nextEvent];
+			(e.startObstacle ? added : removed).push_back(e.idx);
+		}
+		sort(added.begin(), added.end());
+		sort(removed.begin(), removed.end());
+		// An obstacle that starts and ends before z is in both lists.
+		vector<int> endedNew = vectorIntersection(added, removed);
+		added = vectorDifference(added, endedNew);
+		removed = vectorDifference(removed, endedNew);
+
+		vector<int>& obsIndex = section.obsIndex;
+		obsIndex.reserve(prevObsIndex.size() + added.size());
+		set_union(prevObsIndex.begin(), prevObsIndex.end(), added.begin(), added.end(),
+				back_inserter(obsIndex));
+		obsIndex = vectorDifference(obsIndex, removed);
+		prevObsIndex = obsIndex;
+		section.added = move(added);
+		section.removed = move(removed);
+		section.z = z;
+	}
+
+	void mergeCrossSection(CrossSection& section) {
+		Decomposition<D-1>& curPlane = section.plane;
 		vector<int> planeIndex(curPlane.size());
 		IndexedBoxes<D-1> removedCells;
-		mergePlaneResults(curPlane, z, planeIndex, removedCells);
+		mergePlaneResults(curPlane, section.z, planeIndex, removedCells);
 		for(size_t i=0; i<curPlane.size(); ++i) {
 			Cell<D>& target = decomposition[planeIndex[i]];
 			for(int j=0; j<2*(D-1); ++j) {
@@ -270,50 +540,49 @@ public:
 					target.links[j].push_back(planeIndex[x]);
 				}
 				for(int x : curPlane[i].obstacles[j]) {
-					target.obstacles[j].push_back(obsIndex[x]);
+					target.obstacles[j].push_back(section.obsIndex[x]);
 				}
 			}
 		}
-		vector<int> newObs;
-		set_difference(prevObsIndex.begin(), prevObsIndex.end(),
-				obsIndex.begin(), obsIndex.end(),
-				back_inserter(newObs));
-		vector<Box<D-1>> newObsBox;
-		for(int i: newObs) newObsBox.push_back(obstacles[i].box.project());
-//		overlappingBoxes(removedBoxes, newObsBox);
-
-		prevObsIndex = obsIndex;
 	}
 
-	Decomposition<3>& result() { return decomposition; }
-
-private:
+	// Matches the cells of the new plane with the active cells by their
+	// boxes. Both are sorted by box, so one merge finds the cells that
+	// continue, the ones that end at curZ and the ones that start there.
 	void mergePlaneResults(Decomposition<D-1>& plane, int curZ,
 			vector<int>& planeIndex, IndexedBoxes<D-1>& removedCells) {
-		map<Box<D-1>, int> newMap;
-		vector<Box<D-1>> addedBoxes;
-		vector<int> addedIndex;
-		for(size_t i=0; i<plane.size(); ++i) {
+		vector<int> order(plane.size());
+		iota(order.begin(), order.end(), 0);
+		sort(order.begin(), order.end(), [&](int a, int b) { return plane[a].box < plane[b].box; });
+		vector<pair<Box<D-1>, int>> newActive;
+		newActive.reserve(plane.size());
+		size_t j = 0;
+		for(int i: order) {
 			const Box<D-1>& box = plane[i].box;
-			auto it = activeIndex.find(box);
-			int index;
-			if (it != activeIndex.end()) {
-				index = it->second;
-				activeIndex.erase(it);
+			for(; j < activeIndex.size() && activeIndex[j].first < box; ++j) {
+				removeActive(activeIndex[j], curZ, removedCells);
+			}
+			if (j < activeIndex.size() && !(box < activeIndex[j].first)) {
+				planeIndex[i] = activeIndex[j++].second;
 			} else {
-				index = decomposition.size();
-				decomposition.emplace_back(fromProj(box, curZ));
-				addedBoxes.push_back(box);
-				addedIndex.push_back(index);
+				planeIndex[i] = -1;
 			}
-			newMap[box] = index;
-			planeIndex[i] = index;
+			newActive.emplace_back(box, planeIndex[i]);
 		}
-		for(auto p : activeIndex) {
-			decomposition[p.second].box[D-1].to = curZ;
-			removedCells.add(p.second, p.first);
+		for(; j < activeIndex.size(); ++j) removeActive(activeIndex[j], curZ, removedCells);
+
+		vector<Box<D-1>> addedBoxes;
+		vector<int> addedIndex;
+		for(size_t i=0; i<plane.size(); ++i) {
+			if (planeIndex[i] >= 0) continue;
+			planeIndex[i] = decomposition.size();
+			decomposition.emplace_back(fromProj(plane[i].box, curZ));
+			addedBoxes.push_back(plane[i].box);
+			addedIndex.push_back(planeIndex[i]);
 		}
-		activeIndex = move(newMap);
+		for(size_t k=0; k<order.size(); ++k) newActive[k].second = planeIndex[order[k]];
+		activeIndex = move(newActive);
+
 		auto newLinks = overlappingBoxes(removedCells.box, addedBoxes);
 		for(auto p: newLinks) {
 			int a = removedCells.index[p.first];
@@ -323,6 +592,48 @@ private:
 		}
 	}
 
+	void removeActive(const pair<Box<D-1>, int>& cell, int curZ, IndexedBoxes<D-1>& removedCells) {
+		decomposition[cell.second].box[D-1].to = curZ;
+		removedCells.add(cell.second, cell.first);
+	}
+
+	// The boxes of the obstacles that start or end in the cross section,
+	// except for those that end where an equal obstacle starts: the cross
+	// section does not change there.
+	vector<Box<D-1>> changedBoxes(const CrossSection& section) const {
+		vector<pair<int, Box<D-1>>> added, removed, changed;
+		for(int i: section.added) added.emplace_back(obstacles[i].direction, obstacles[i].box.project());
+		for(int i: section.removed) removed.emplace_back(obstacles[i].direction, obstacles[i].box.project());
+		sort(added.begin(), added.end());
+		sort(removed.begin(), removed.end());
+		set_symmetric_difference(added.begin(), added.end(), removed.begin(), removed.end(),
+				back_inserter(changed));
+		vector<Box<D-1>> boxes;
+		boxes.reserve(changed.size());
+		for(const auto& obs: changed) boxes.push_back(obs.second);
+		return boxes;
+	}
+
+	// Whether the boxes overlap on the axes of the cross section other than
+	// the given one.
+	static bool overlapsBeside(const Box<D>& a, const Box<D>& b, int axis) {
+		for(int i=0; i<D-1; ++i) {
+			if (i != axis && !a[i].intersects(b[i])) return false;
+		}
+		return true;
+	}
+
+	static void eraseValue(vector<int>& v, int x) {
+		auto it = find(v.begin(), v.end(), x);
+		*it = v.back();
+		v.pop_back();
+	}
+
+	static Box<D-1> boxUnion(Box<D-1> a, const Box<D-1>& b) {
+		for(int i=0; i<D-1; ++i) a[i] = a[i].union_(b[i]);
+		return a;
+	}
+
 	static Box<D> fromProj(const Box<D-1>& from, int start) {
 		Box<D> box;
 		for(int k=0; k<D-1; ++k) box[k] = from[k];
@@ -333,30 +644,40 @@ private:
 	ObstacleSet<D> obstacles;
 
 	Decomposition<D> decomposition;
-	Decomposition<D> activeCells;
 
-	map<Box<D-1>, int> activeIndex;
+	// The boxes of the cells that reach the current depth with their
+	// indices, sorted by box.
+	vector<pair<Box<D-1>, int>> activeIndex;
+	// The obstacles in the cross section of the previous depth, sorted.
 	vector<int> prevObsIndex;
+	// For updateToDepth: the active cells by the coordinate of their side
+	// in direction d, and the obstacles of the cross section with
+	// direction d by their coordinate.
+	array<unordered_map<int, vector<int>>, 2*(D-1)> sideCells;
+	array<unordered_map<int, vector<int>>, 2*(D-1)> sideObstacles;
+	// Starts and ends of the obstacles along the sweep axis.
+	vector<Event> events;
+	size_t nextEvent = 0;
 };
 
 template<int D, class T>
-vector<Box<D-1>> getProjBoxesT(const T& items, Span<const int> idx) {
+vector<Box<D-1>> getProjBoxesT(const T& items, Span<const int> idx, int axis) {
 	vector<Box<D-1>> boxes;
 	boxes.reserve(idx.size());
 	for(int i: idx) {
-		boxes.push_back(items[i].box.project());
+		boxes.push_back(items[i].box.project(axis));
 	}
 	return boxes;
 }
 
 template<int D>
-vector<Box<D-1>> getProjBoxes(const Decomposition<D>& items, Span<const int> idx) {
-	return getProjBoxesT<D>(items, idx);
+vector<Box<D-1>> getProjBoxes(const Decomposition<D>& items, Span<const int> idx, int axis) {
+	return getProjBoxesT<D>(items, idx, axis);
 }
 
 template<int D>
-vector<Box<D-1>> getProjBoxes(const ObstacleSet<D>& items, Span<const int> idx) {
-	return getProjBoxesT<D>(items, idx);
+vector<Box<D-1>> getProjBoxes(const ObstacleSet<D>& items, Span<const int> idx, int axis) {
+	return getProjBoxesT<D>(items, idx, axis);
 }
 
 template<int D>
@@ -385,17 +706,17 @@ void computeLinksInDir(Decomposition<D>& decomposition, const ObstacleSet<D>& ob
 	for(int z: zs) {
 		const auto& dt = decTo[z];
 		const auto& df = decFrom[z];
-		for(auto p : overlappingBoxes(getProjBoxes(decomposition, dt), getProjBoxes(decomposition, df))) {
+		for(auto p : overlappingBoxes(getProjBoxes(decomposition, dt, axis), getProjBoxes(decomposition, df, axis))) {
 			int a = dt[p.first], b = df[p.second];
 			decomposition[a].links[2*axis+1].push_back(b);
 			decomposition[b].links[2*axis].push_back(a);
 		}
 		const auto& ot = obsTo[z];
 		const auto& of = obsFrom[z];
-		for(auto p : overlappingBoxes(getProjBoxes(decomposition, dt), getProjBoxes(obstacles, of))) {
+		for(auto p : overlappingBoxes(getProjBoxes(decomposition, dt, axis), getProjBoxes(obstacles, of, axis))) {
 			decomposition[dt[p.first]].obstacles[2*axis+1].push_back(of[p.second]);
 		}
-		for(auto p : overlappingBoxes(getProjBoxes(decomposition, df), getProjBoxes(obstacles, ot))) {
+		for(auto p : overlappingBoxes(getProjBoxes(decomposition, df, axis), getProjBoxes(obstacles, ot, axis))) {
 			decomposition[df[p.first]].obstacles[2*axis].push_back(ot[p.second]);
 		}
 	}
@@ -404,18 +725,28 @@ void computeLinksInDir(Decomposition<D>& decomposition, const ObstacleSet<D>& ob
 //} // namespace
 
 template<int D>
-Decomposition<D> decomposeFreeSpace(const ObstacleSet<D>& obstacles) {
+Decomposition<D> decomposeFreeSpace(const ObstacleSet<D>& obstacles, int threads, SweepMode mode) {
+	// The update also stops where obstacles start without changing the
+	// cross section, to give them to the cells next to them.
 	vector<int> depths;
 	for(const auto& obs: obstacles) {
-		if (obs.box[Z_AXIS].size() == 0) {
-			depths.push_back(obs.box[Z_AXIS].from);
+		if (obs.box[D-1].size() == 0 || mode == SweepMode::INCREMENTAL) {
+			depths.push_back(obs.box[D-1].from);
 		}
 	}
 	sortUnique(depths);
 
 	SweepState<D> state(obstacles);
-	for(int z: depths) {
-		state.advanceToDepth(z);
+	if (mode == SweepMode::INCREMENTAL) {
+		for(int z: depths) {
+			state.updateToDepth(z);
+		}
+	} else if (threads > 1) {
+		state.advanceToDepths(depths, threads);
+	} else {
+		for(int z: depths) {
+			state.advanceToDepth(z);
+		}
 	}
 	Decomposition<D> decomposition = move(state.result());
 	computeLinksInDir(decomposition, obstacles, D-1);
@@ -424,4 +755,6 @@ Decomposition<D> decomposeFreeSpace(const ObstacleSet<D>& obstacles) {
 }
 
 template
-Decomposition<3> decomposeFreeSpace<3>(const ObstacleSet<3>& obstacles);
+Decomposition<3> decomposeFreeSpace<3>(const ObstacleSet<3>& obstacles, int threads, SweepMode mode);
+template
+Decomposition<4> decomposeFreeSpace<4>(const ObstacleSet<4>& obstacles, int threads, SweepMode mode);
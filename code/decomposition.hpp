@@ -32,5 +32,21 @@ std::ostream& operator<<(std::ostream& o, const Obstacle<D>& x) {
 template<int D>
 using ObstacleSet = std::vector<Obstacle<D>>;
 
+// How the sweep of decomposeFreeSpace finds the cells of each cross
+// section for D > 2.
+enum class SweepMode {
+	// Decomposes every cross section from scratch, on the given number of
+	// threads.
+	FULL,
+	// Updates the cells of the previous cross section around the obstacles
+	// that start or end at the depth, on one thread. The cells are the same
+	// as with FULL but not in the same order.
+	INCREMENTAL,
+};
+
+// Decomposes the free space into boxes by sweeping along the last axis.
+// For D > 2 the cross sections at different depths are decomposed on the
+// given number of threads; the result does not depend on it.
 template<int D>
-Decomposition<D> decomposeFreeSpace(const ObstacleSet<D>& obstacles);
+Decomposition<D> decomposeFreeSpace(const ObstacleSet<D>& obstacles, int threads = 1,
+		SweepMode mode = SweepMode::FULL);
@@ -1,6 +1,8 @@
 #include "decomposition.hpp"
 #include "obstacles.hpp"
+#include <algorithm>
 #include <cstring>
+#include <random>
 #include <gmock/gmock-more-matchers.h>
 #include <gtest/gtest.h>
 
@@ -221,4 +223,105 @@ TEST(DecompositionTest3D, DecomposeDeepCells) {
 	checkObstacles(result, obs);
 }
 
+vector<vector<string>> randomVolume(int size, mt19937& rng) {
+	vector<vector<string>> volume(size, vector<string>(size, string(size, '.')));
+	for(auto& plane: volume) {
+		for(string& row: plane) {
+			for(char& c: row) {
+				if (rng()%3 == 0) c = '#';
+			}
+		}
+	}
+	return volume;
+}
+
+TEST(DecompositionTest3D, Random) {
+	mt19937 rng(1);
+	for(int i=0; i<20; ++i) {
+		ObstacleSet<3> obs = makeObstaclesForVolume(randomVolume(5, rng));
+		Decomposition<3> result = decomposeFreeSpace(obs);
+		checkLinks(result);
+		checkObstacles(result, obs);
+	}
+}
+
+TEST(DecompositionTest3D, Parallel) {
+	mt19937 rng(2);
+	for(int i=0; i<20; ++i) {
+		ObstacleSet<3> obs = makeObstaclesForVolume(randomVolume(8, rng));
+		Decomposition<3> expected = decomposeFreeSpace(obs);
+		Decomposition<3> result = decomposeFreeSpace(obs, 4);
+		ASSERT_THAT(getBoxes(result), ElementsAreArray(getBoxes(expected)));
+		for(size_t j=0; j<result.size(); ++j) {
+			for(int d=0; d<6; ++d) {
+				EXPECT_EQ(result[j].links[d], expected[j].links[d]);
+				EXPECT_EQ(result[j].obstacles[d], expected[j].obstacles[d]);
+			}
+		}
+	}
+}
+
+template<int D>
+vector<Box<D>> getSortedBoxes(const Decomposition<D>& dec) {
+	vector<Box<D>> boxes = getBoxes(dec);
+	sort(boxes.begin(), boxes.end());
+	return boxes;
+}
+
+template<int D>
+void checkIncremental(const ObstacleSet<D>& obs) {
+	Decomposition<D> result = decomposeFreeSpace(obs, 1, SweepMode::INCREMENTAL);
+	EXPECT_THAT(getSortedBoxes(result), ElementsAreArray(getSortedBoxes(decomposeFreeSpace(obs))));
+	checkLinks(result);
+	checkObstacles(result, obs);
+}
+
+TEST(DecompositionTest3D, Incremental) {
+	checkIncremental(makeObstaclesForVolume({
+				{"...",
+				 ".#.",
+				 "..."},
+				{"...",
+				 "##.",
+				 "..."},
+				{"...",
+				 "##.",
+				 ".#."},
+			}));
+	mt19937 rng(4);
+	for(int i=0; i<20; ++i) {
+		checkIncremental(makeObstaclesForVolume(randomVolume(8, rng)));
+	}
+	// Few changes per depth, so the updates only decompose small windows.
+	Point<3> size = {9, 8, 10};
+	for(int i=0; i<20; ++i) {
+		vector<bool> blocked(9*8*10);
+		for(size_t j=0; j<blocked.size(); ++j) blocked[j] = rng()%20 == 0;
+		checkIncremental(makeObstaclesForGrid<3>(size, blocked));
+	}
+}
+
+TEST(DecompositionTest4D, Random) {
+	mt19937 rng(3);
+	Point<4> size = {3, 4, 3, 4};
+	for(int i=0; i<20; ++i) {
+		vector<bool> blocked(3*4*3*4);
+		for(size_t j=0; j<blocked.size(); ++j) blocked[j] = rng()%3 == 0;
+		ObstacleSet<4> obs = makeObstaclesForGrid<4>(size, blocked);
+		Decomposition<4> result = decomposeFreeSpace(obs);
+		checkLinks(result);
+		checkObstacles(result, obs);
+	}
+}
+
+TEST(DecompositionTest4D, Incremental) {
+	mt19937 rng(5);
+	Point<4> size = {3, 4, 3, 4};
+	for(int i=0; i<20; ++i) {
+		vector<bool> blocked(3*4*3*4);
+		for(size_t j=0; j<blocked.size(); ++j) blocked[j] = rng()%3 == 0;
+		checkIncremental(makeObstaclesForGrid<4>(size, blocked));
+	}
+}
+
 } // namespace
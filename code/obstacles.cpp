@@ -181,8 +181,85 @@ vector<vector<string>> swapYZ(const vector<vector<string>>& volume) {
 	return res;
 }
 
+// The grid of makeObstaclesForGrid with its border.
+template<int D>
+struct VoxelGrid {
+	VoxelGrid(Point<D> sz, const vector<bool>& blocked): blocked(blocked) {
+		for(int i=0; i<D; ++i) size[i] = sz[i]+2;
+	}
+
+	bool isBlocked(const Point<D>& p) const {
+		int index = 0;
+		for(int i=D-1; i>=0; --i) {
+			if (p[i] <= 0 || p[i] >= size[i]-1) return true;
+			index = index*(size[i]-2) + p[i]-1;
+		}
+		return blocked[index];
+	}
+
+	// Adds the faces of the blocked voxels towards dir, joining the faces
+	// next to each other along runAxis into one obstacle.
+	void addObstacles(ObstacleSet<D>& result, int dir, int runAxis) const {
+		int axis = dir/2;
+		Point<D> step = dirVec<D>(dir);
+		Point<D> p;
+		while(true) {
+			int count = 0;
+			for(p[runAxis]=0; p[runAxis]<=size[runAxis]; ++p[runAxis]) {
+				if (p[runAxis] < size[runAxis] && hasFace(p, step, axis)) {
+					++count;
+					continue;
+				}
+				if (count) {
+					Box<D> box;
+					for(int i=0; i<D; ++i) box[i] = {p[i], p[i]+1};
+					box[runAxis] = {p[runAxis]-count, p[runAxis]};
+					int x = step[axis] > 0 ? p[axis]+1 : p[axis];
+					box[axis] = {x, x};
+					result.push_back({box, dir});
+				}
+				count = 0;
+			}
+			// Moves to the next line along runAxis.
+			int i = 0;
+			for(; i<D; ++i) {
+				if (i == runAxis) continue;
+				if (++p[i] < size[i]) break;
+				p[i] = 0;
+			}
+			if (i == D) break;
+		}
+	}
+
+	bool hasFace(const Point<D>& p, const Point<D>& step, int axis) const {
+		Point<D> q = p;
+		q[axis] += step[axis];
+		return q[axis] >= 0 && q[axis] < size[axis] && isBlocked(p) && !isBlocked(q);
+	}
+
+	Point<D> size;
+	const vector<bool>& blocked;
+};
+
 } // namespace
 
+template<int D>
+ObstacleSet<D> makeObstaclesForGrid(Point<D> size, const vector<bool>& blocked) {
+	VoxelGrid<D> grid(size, blocked);
+	ObstacleSet<D> result;
+	for(int dir=0; dir<2*D; ++dir) {
+		grid.addObstacles(result, dir, dir/2 == 0 ? 1 : 0);
+	}
+	return result;
+}
+
+template
+ObstacleSet<2> makeObstaclesForGrid<2>(Point<2> size, const vector<bool>& blocked);
+template
+ObstacleSet<3> makeObstaclesForGrid<3>(Point<3> size, const vector<bool>& blocked);
+template
+ObstacleSet<4> makeObstaclesForGrid<4>(Point<4> size, const vector<bool>& blocked);
+
 ObstacleSet<2> makeObstaclesForPlane(const vector<string>& area0) {
 	const vector<string> area = addBorderAroundArea(area0);
 	ObstacleSet<2> result;
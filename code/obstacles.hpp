@@ -4,3 +4,10 @@
 
 ObstacleSet<2> makeObstaclesForPlane(const std::vector<std::string>& area);
 ObstacleSet<3> makeObstaclesForVolume(std::vector<std::vector<std::string>> volume);
+
+// Obstacles around the blocked voxels of a D-dimensional grid, which is
+// surrounded by a border of blocked voxels like in the functions above.
+// blocked[i] is the voxel whose coordinates p give i = p[0] + size[0]*(p[1]
+// + size[1]*(...)), and the voxel p is at p+1 in the obstacle coordinates.
+template<int D>
+ObstacleSet<D> makeObstaclesForGrid(Point<D> size, const std::vector<bool>& blocked);
@@ -1,13 +1,18 @@
 #include "path.hpp"
 
+#include "BucketQueue.hpp"
 #include "ClearableBitset.hpp"
+#include "CoordinateCompression.hpp"
+#include "PointLocator.hpp"
 #include "print.hpp"
+#include "Trace.hpp"
 #include "UnifiedTree.hpp"
 #include "util.hpp"
+#include "WorkerPool.hpp"
 
 #include <algorithm>
 #include <cassert>
-#include <queue>
+#include <numeric>
 
 using namespace std;
 
@@ -22,11 +27,6 @@ struct Event {
 	int cell = -1;
 	int position = -1;
 	Box<D-1> box;
-
-	bool operator<(const Event& e) const {
-		if (position != e.position) return position < e.position;
-		return (int)type > (int)e.type;
-	}
 };
 
 template<int D>
@@ -112,6 +112,7 @@ struct EventSet {
 	}
 	void clear() {
 		for(auto& v: events) v.clear();
+		cells.clear();
 	}
 	void genCellEvents(const Decomposition<D>& dec);
 
@@ -137,10 +138,6 @@ struct TreeItem {
 	int start = -1;
 };
 
-ostream& operator<<(ostream& out, const TreeItem& item) {
-	return out<<"("<<item.start<<")";
-}
-
 template<int D>
 Event<D> cellEvent(const Decomposition<D>& dec, int dir, int cell) {
 	Event<D> event;
@@ -182,6 +179,19 @@ Event<D> addRectEvent(const Box<D>& box, int dir) {
 	return event;
 }
 
+// Bounds the absolute value of the sweep event positions.
+template<int D>
+int maxCoordinate(const ObstacleSet<D>& obs, const Decomposition<D>& dec) {
+	int s = 0;
+	for(const Obstacle<D>& o: obs) {
+		for(int i=0; i<D; ++i) s = max(s, o.box[i].to);
+	}
+	for(const Cell<D>& c: dec) {
+		for(int i=0; i<D; ++i) s = max(s, c.box[i].to);
+	}
+	return s;
+}
+
 template<int D>
 array<int, D-1> buildSize(const Decomposition<D>& dec) {
 	int s = 0;
@@ -195,17 +205,184 @@ array<int, D-1> buildSize(const Decomposition<D>& dec) {
 	return arr;
 }
 
+// Query targets sorted by their first coordinate, so that the targets inside
+// an illuminated box can be found with a binary search.
 template<int D>
-struct IlluminateState {
+struct TargetSet {
+	struct Target {
+		Point<D> point;
+		int index = -1;
+	};
+
+	void reset(const vector<Point<D>>& points) {
+		targets.clear();
+		for(int i=0; i<(int)points.size(); ++i) {
+			targets.push_back({points[i], i});
+		}
+		sort(targets.begin(), targets.end(), [](const Target& a, const Target& b) {
+			return a.point[0] < b.point[0];
+		});
+		distances.assign(points.size(), -1);
+		remaining = points.size();
+		nextUnresolved.resize(points.size() + 1);
+		iota(nextUnresolved.begin(), nextUnresolved.end(), 0);
+	}
+
+	// Resolved targets are skipped, so a box only looks at the targets of
+	// its slab that are still unresolved.
+	void resolve(const Box<D>& box, int distance) {
+		if (done()) return;
+		auto it = lower_bound(targets.begin(), targets.end(), box[0].from,
+				[](const Target& t, int x) { return t.point[0] < x; });
+		for(int i = findUnresolved(it - targets.begin());
+				i < (int)targets.size() && targets[i].point[0] < box[0].to;
+				i = findUnresolved(i+1)) {
+			if (box.contains(targets[i].point)) {
+				distances[targets[i].index] = distance;
+				nextUnresolved[i] = i+1;
+				--remaining;
+			}
+		}
+	}
+
+	bool done() const { return remaining == 0; }
+
+	vector<Target> targets;
+	vector<int> distances;
+	int remaining = 0;
+
+private:
+	// The first unresolved target at index i or after it, or the number of
+	// targets. Resolved targets point past themselves, and the links are
+	// shortened on the way.
+	int findUnresolved(int i) {
+		while(nextUnresolved[i] != i) {
+			nextUnresolved[i] = nextUnresolved[nextUnresolved[i]];
+			i = nextUnresolved[i];
+		}
+		return i;
+	}
+
+	vector<int> nextUnresolved;
+};
+
+// Box illuminated in one round by sweeping along axis from the face at start.
+template<int D>
+struct IlluminatedRect {
+	Box<D> box;
+	int axis = -1;
+	int start = -1;
+
+	// Moves pt along the sweep axis to the cell just behind the starting face.
+	Point<D> source(Point<D> pt) const {
+		pt[axis] = box[axis].from == start ? start-1 : start;
+		return pt;
+	}
+};
+
+// Plane and output buffers of a directional sweep. In parallel mode every
+// direction has its own context, so that the sweeps of a round can run on
+// separate threads; the outputs are merged in direction order afterwards.
+template<int D>
+struct SweepContext {
 	typedef UnifiedTree<TreeItem, D-1> Plane;
+
+	SweepContext(const ObstacleSet<D>& obs, const Decomposition<D>& dec):
+		plane(buildSize(dec)),
+		events(-maxCoordinate(obs, dec), maxCoordinate(obs, dec)),
+		visitedCells(dec.size()),
+		visitedObstacles(obs.size()) {}
+
+	void clear() {
+		rects.clear();
+		cells.clear();
+		reachedObstacles.clear();
+	}
+
+	Plane plane;
+	// Sweep events keyed by position and ordered by EventType within a
+	// position. The item is the cell or obstacle index, or the index of the
+	// event in the round's event list for ADD_RECT events.
+	BucketQueue<int, 3> events;
+	ClearableBitset visitedCells;
+	ClearableBitset visitedObstacles;
+
+	// Illuminated boxes and whether they still start new rectangles.
+	vector<pair<IlluminatedRect<D>, bool>> rects;
+	vector<int> cells;
+	vector<int> reachedObstacles;
+
+	// Rectangles added to the empty plane at the start of a sweep.
+	vector<pair<Box<D-1>, TreeItem>> initialRects;
+	// Scratch space for checking the neighbours of a cell.
+	vector<int> neighbours;
+	vector<Box<D-1>> neighbourBoxes;
+	vector<bool> lit;
+};
+
+template<int D>
+struct IlluminateState {
+	typedef typename SweepContext<D>::Plane Plane;
 	using Index = typename Plane::Index;
 
-	IlluminateState(ObstacleSet<D> obs):
-		obstacles(obs), decomposition(decomposeFreeSpace(obstacles)),
-	plane(buildSize(decomposition)),
-	obstacleReachTime(obstacles.size(), -1),
-	visitedCells(decomposition.size()),
-	visitedObstacles(obstacles.size()) {}
+	IlluminateState(const ObstacleSet<D>& obs, const Decomposition<D>& dec, bool parallel = false):
+		obstacles(obs), decomposition(dec),
+		obstacleReachTime(obstacles.size(), -1) {
+		setParallel(parallel);
+	}
+
+	// The threads of the parallel sweeps are kept for all rounds.
+	void setParallel(bool parallel) {
+		contexts.clear();
+		int n = parallel ? 2*D : 1;
+		for(int i=0; i<n; ++i) contexts.emplace_back(obstacles, decomposition);
+		workers.reset(parallel ? new WorkerPool(2*D) : nullptr);
+	}
+
+	bool parallel() const { return contexts.size() > 1; }
+
+	SweepContext<D>& context(int dir) {
+		return contexts[parallel() ? dir : 0];
+	}
+
+	void reset() {
+		curEvents.clear();
+		nextEvents.clear();
+		for(auto& ctx: contexts) {
+			ctx.plane.clear();
+			ctx.clear();
+		}
+		for(int obs: reachedObstacles) obstacleReachTime[obs] = -1;
+		reachedObstacles.clear();
+		rounds.clear();
+		curStep = 0;
+	}
+
+	void start(const Box<D>& startBox, int startCell) {
+		curEvents.cells.push_back(startCell);
+		for(int i=0; i<2*D; ++i) {
+			curEvents.events[i].push_back(addRectEvent(startBox, i));
+		}
+		curEvents.genCellEvents(decomposition);
+	}
+
+	void runRound() {
+		Trace::event(TraceType::ROUND, -1, curStep);
+		if (parallel()) {
+			workers->run([this](int dir) { sweep(dir); });
+			for(int i=0; i<2*D; ++i) collect(i);
+		} else {
+			for(int i=0; i<2*D; ++i) {
+				sweep(i);
+				collect(i);
+			}
+		}
+		newRound();
+	}
+
+	bool finished() const {
+		return curEvents.empty();
+	}
 
 	void newRound() {
 		++curStep;
@@ -216,101 +393,167 @@ struct IlluminateState {
 	}
 
 	void sweep(int dir) {
-		cout<<"    sweep "<<dir<<'\n';
-		visitedCells.reset();
-		visitedObstacles.reset();
+		Trace::event(TraceType::SWEEP, -1, dir);
+		SweepContext<D>& ctx = context(dir);
+		Plane& plane = ctx.plane;
+		ctx.visitedCells.reset();
+		ctx.visitedObstacles.reset();
 		const int axis = dir/2;
-		priority_queue<Event<D>> events(curEvents.events[dir].begin(), curEvents.events[dir].end());
+		auto& events = ctx.events;
+		const auto& roundEvents = curEvents.events[dir];
+		for(int i=0; i<(int)roundEvents.size(); ++i) {
+			const Event<D>& e = roundEvents[i];
+			events.push(e.position, (int)e.type, e.type == EventType::ADD_RECT ? i : e.cell);
+		}
+		auto push = [&](const Event<D>& e) {
+			events.push(e.position, (int)e.type, e.cell);
+		};
+		// The rectangles that come before all other events are built into
+		// the plane at once. The first other event is kept for the loop.
+		ctx.initialRects.clear();
+		bool pending = false;
+		typename BucketQueue<int, 3>::Entry entry;
 		while(!events.empty()) {
-			Event<D> event = events.top();
-			cout<<"event "<<event<<'\n';
-			events.pop();
-			int position = dir&1 ? -event.position : event.position;
-
-			if (event.type == EventType::ADD_RECT) {
-				plane.add(event.box, {position});
-				cout<<"add box "<<event.box<<'\n';
-			} else if (event.type == EventType::CELL) {
-				const Cell<D>& cell = decomposition[event.cell];
+			entry = events.pop();
+			if ((EventType)entry.cls != EventType::ADD_RECT) {
+				pending = true;
+				break;
+			}
+			int position = dir&1 ? -entry.key : entry.key;
+			const Box<D-1>& box = roundEvents[entry.item].box;
+			Trace::event(TraceType::ADD_RECT, -1, position, box);
+			ctx.initialRects.push_back({box, {position}});
+		}
+		plane.build(ctx.initialRects);
+		while(pending || !events.empty()) {
+			if (!pending) entry = events.pop();
+			pending = false;
+			EventType type = (EventType)entry.cls;
+			int position = dir&1 ? -entry.key : entry.key;
+
+			if (type == EventType::ADD_RECT) {
+				const Box<D-1>& box = roundEvents[entry.item].box;
+				Trace::event(TraceType::ADD_RECT, -1, position, box);
+				plane.add(box, {position});
+			} else if (type == EventType::CELL) {
+				int c = entry.item;
+				Trace::event(TraceType::CELL, c, position);
+				const Cell<D>& cell = decomposition[c];
 				if (!plane.check(cell.box.project(axis))) {
 					continue;
 				}
-				nextEvents.cells.push_back(event.cell);
+				ctx.cells.push_back(c);
 				for(int obs: cell.obstacles[dir]) {
-					if (visitedObstacles[obs]) continue;
-					visitedObstacles.set(obs);
-					events.push(obstacleEvent(obstacles, dir, obs));
+					if (ctx.visitedObstacles[obs]) continue;
+					ctx.visitedObstacles.set(obs);
+					push(obstacleEvent(obstacles, dir, obs));
 				}
+				ctx.neighbours.clear();
+				ctx.neighbourBoxes.clear();
 				for(int nb: cell.links[dir]) {
-					Box<D-1> box = decomposition[nb].box.project(axis);
-					if (plane.check(box) && !visitedCells[nb]) {
-						visitedCells.set(nb);
-						events.push(cellEvent(decomposition, dir, nb));
+					if (ctx.visitedCells[nb]) continue;
+					ctx.neighbours.push_back(nb);
+					ctx.neighbourBoxes.push_back(decomposition[nb].box.project(axis));
+				}
+				const Box<D-1>* nbBoxes = ctx.neighbourBoxes.data();
+				plane.checkBatch({nbBoxes, nbBoxes + ctx.neighbourBoxes.size()}, ctx.lit);
+				for(size_t k=0; k<ctx.neighbours.size(); ++k) {
+					int nb = ctx.neighbours[k];
+					if (ctx.lit[k] && !ctx.visitedCells[nb]) {
+						ctx.visitedCells.set(nb);
+						push(cellEvent(decomposition, dir, nb));
 					}
 				}
 			} else {
-				int& time = obstacleReachTime[event.cell];
+				int obs = entry.item;
+				Trace::event(TraceType::OBSTACLE, obs, position);
+				// Obstacles first reached in this round get their reach time
+				// when the round is collected.
+				int time = obstacleReachTime[obs];
 				if (time<0) {
 					time = curStep;
+					ctx.reachedObstacles.push_back(obs);
 				}
-				Box<D-1> box = obstacles[event.cell].box.project(dir/2);
-				cout<<"remove box "<<box<<'\n';
+				Box<D-1> box = obstacles[obs].box.project(dir/2);
+				Trace::event(TraceType::REMOVE_RECT, obs, position, box);
 				plane.remove(box, [&](Index idx, const TreeItem& item) {
-					onRemove(axis, idx, item, position, time);
+					onRemove(ctx, axis, idx, item, position, time);
 				});
 			}
 		}
 	}
 
-	void onRemove(int axis, Index index, const TreeItem& item, int position, int obsTime) {
+	void onRemove(SweepContext<D>& ctx, int axis, Index index, const TreeItem& item, int position, int obsTime) {
 		Range range = item.start<position ? Range{item.start, position} : Range{position, item.start};
-		cout<<"Remove "<<axis<<' '<<index<<' '<<item<<' '<<position<<'\n';
 		if (item.start == position) return;
 		Box<D> box;
 		for(int i=0; i<D; ++i) {
-			box[i] = i<axis ? plane.rangeForIndex(i, index[i])
+			box[i] = i<axis ? ctx.plane.rangeForIndex(i, index[i])
 				: i==axis ? range
-				: plane.rangeForIndex(i-1, index[i-1]);
-		}
-		cout<<"rm box "<<box<<'\n';
-		if (box.contains(endP)) {
-			endFound = true;
+				: ctx.plane.rangeForIndex(i-1, index[i-1]);
 		}
-		if (curStep > obsTime + D + 1) {
-			return;
+		Trace::event(TraceType::ILLUMINATE, axis, position, box);
+		ctx.rects.push_back({{box, axis, item.start}, curStep <= obsTime + D + 1});
+	}
+
+	// Moves the results of the sweep in direction dir to the next round.
+	void collect(int dir) {
+		SweepContext<D>& ctx = context(dir);
+		for(const auto& p: ctx.rects) {
+			const IlluminatedRect<D>& rect = p.first;
+			targets.resolve(rect.box, curStep+1);
+			if (recordRects) {
+				if ((int)rounds.size() <= curStep) rounds.resize(curStep+1);
+				rounds[curStep].push_back(rect);
+			}
+			if (!p.second) continue;
+			for(int i=0; i<2*D; ++i) {
+				if (i/2 != rect.axis) {
+					nextEvents.events[i].push_back(addRectEvent(rect.box, i));
+				}
+			}
 		}
-		for(int i=0; i<2*D; ++i) {
-			if (i/2 != axis) {
-				nextEvents.events[i].push_back(addRectEvent(box, i));
+		nextEvents.cells.insert(nextEvents.cells.end(), ctx.cells.begin(), ctx.cells.end());
+		for(int obs: ctx.reachedObstacles) {
+			int& time = obstacleReachTime[obs];
+			if (time<0) {
+				time = curStep;
+				reachedObstacles.push_back(obs);
 			}
 		}
+		ctx.clear();
 	}
 
-	const ObstacleSet<D> obstacles;
-	const Decomposition<D> decomposition;
-	Point<D> endP;
-	bool endFound = false;
+	const ObstacleSet<D>& obstacles;
+	const Decomposition<D>& decomposition;
+	TargetSet<D> targets;
+	bool recordRects = false;
+	vector<vector<IlluminatedRect<D>>> rounds;
 
 	EventSet<D> curEvents;
 	EventSet<D> nextEvents;
 
-	Plane plane;
-
+	vector<SweepContext<D>> contexts;
+	unique_ptr<WorkerPool> workers;
 	vector<int> obstacleReachTime;
-	ClearableBitset visitedCells;
-	ClearableBitset visitedObstacles;
+	// The obstacles whose reach time is set, so that reset only clears them.
+	vector<int> reachedObstacles;
 
 	int curStep = 0;
 };
 
+// The points reached from one side of a bidirectional query.
+struct ReachedItem {};
+
 template<int D>
-int pointCell(const Decomposition<D>& dec, Point<D> pt) {
-	int i=0;
-	while(!dec[i].box.contains(pt)) {
-		++i;
-		assert(i < (int)dec.size());
-	}
-	return i;
+using ReachedTree = UnifiedTree<ReachedItem, D, PagedStorage>;
+
+template<int D>
+PointLocator<D> buildLocator(const Decomposition<D>& dec) {
+	vector<Box<D>> boxes;
+	boxes.reserve(dec.size());
+	for(const Cell<D>& c: dec) boxes.push_back(c.box);
+	return PointLocator<D>(boxes);
 }
 
 template<int D>
@@ -323,31 +566,219 @@ Box<D> unitBox(Point<D> pt) {
 } // namespace
 
 template<int D>
-int linkDistance(const ObstacleSet<D>& obstacles, Point<D> startP, Point<D> endP) {
-	IlluminateState<D> state(obstacles);
-	state.endP = endP;
-	const auto& decomposition = state.decomposition;
-	cout<<"decomposition: "<<decomposition<<' '<<startP<<'\n';
-	int startCell = pointCell(decomposition, startP);
+struct LinkDistanceIndex<D>::Impl {
+	Impl(const ObstacleSet<D>& obs, int threads):
+		obstacles(obs), decomposition(decomposeFreeSpace(obstacles, threads)),
+		locator(buildLocator(decomposition)),
+		state(obstacles, decomposition) {}
+
+	const ObstacleSet<D> obstacles;
+	const Decomposition<D> decomposition;
+	const PointLocator<D> locator;
+	IlluminateState<D> state;
+	unique_ptr<IlluminateState<D>> backState;
+	unique_ptr<ReachedTree<D>> reached[2];
+};
+
+template<int D>
+LinkDistanceIndex<D>::LinkDistanceIndex(const ObstacleSet<D>& obstacles, int threads):
+	impl(new Impl(obstacles, threads)) {
+	Trace::event(TraceType::DECOMPOSITION, impl->decomposition.size(), -1);
+}
+
+template<int D>
+LinkDistanceIndex<D>::LinkDistanceIndex(LinkDistanceIndex&&) = default;
+
+template<int D>
+LinkDistanceIndex<D>& LinkDistanceIndex<D>::operator=(LinkDistanceIndex&&) = default;
+
+template<int D>
+LinkDistanceIndex<D>::~LinkDistanceIndex() = default;
+
+template<int D>
+void LinkDistanceIndex<D>::setParallelSweeps(bool parallel) {
+	impl->state.setParallel(parallel);
+	if (impl->backState) impl->backState->setParallel(parallel);
+}
+
+template<int D>
+const Decomposition<D>& LinkDistanceIndex<D>::decomposition() const {
+	return impl->decomposition;
+}
+
+template<int D>
+vector<Point<D>> LinkDistanceIndex<D>::path(Point<D> startP, Point<D> endP) {
+	IlluminateState<D>& state = impl->state;
+	state.recordRects = true;
+	int dist = query(startP, endP);
+	state.recordRects = false;
+	if (dist < 0) return {};
+	vector<Point<D>> result = {endP};
+	Point<D> pt = endP;
+	for(int step=dist-1; step>=0; --step) {
+		const auto& rects = state.rounds[step];
+		auto it = find_if(rects.begin(), rects.end(), [&](const IlluminatedRect<D>& r) {
+			return r.box.contains(pt);
+		});
+		assert(it != rects.end());
+		pt = it->source(pt);
+		result.push_back(pt);
+	}
+	assert(pt == startP);
+	reverse(result.begin(), result.end());
+	return result;
+}
+
+template<int D>
+int LinkDistanceIndex<D>::query(Point<D> startP, Point<D> endP) {
+	return query(startP, vector<Point<D>>{endP})[0];
+}
+
+template<int D>
+vector<int> LinkDistanceIndex<D>::query(Point<D> startP, const vector<Point<D>>& endPs) {
+	IlluminateState<D>& state = impl->state;
+	state.reset();
+	Box<D> startBox = unitBox(startP);
+	state.targets.reset(endPs);
+	state.targets.resolve(startBox, 0);
+	if (state.targets.done()) return state.targets.distances;
+	int startCell = impl->locator.locate(startP);
+	assert(startCell >= 0);
+	state.start(startBox, startCell);
+	while(!state.finished() && !state.targets.done()) {
+		state.runRound();
+	}
+	return state.targets.distances;
+}
+
+template<int D>
+int LinkDistanceIndex<D>::queryBidirectional(Point<D> startP, Point<D> endP) {
 	Box<D> startBox = unitBox(startP);
+	Box<D> endBox = unitBox(endP);
 	if (startBox.contains(endP)) return 0;
-	state.curEvents.cells.push_back(startCell);
-	for(int i=0; i<2*D; ++i) {
-		auto& events = state.curEvents.events[i];
-		events.push_back(addRectEvent(startBox, i));
+	if (!impl->backState) {
+		impl->backState.reset(new IlluminateState<D>(impl->obstacles, impl->decomposition,
+					impl->state.parallel()));
 	}
-	state.curEvents.genCellEvents(decomposition);
-	while(!state.curEvents.empty() && !state.endFound) {
-		cout<<"\nround "<<state.curStep<<'\n';
-		for(int i=0; i<2*D; ++i) {
-			state.sweep(i);
+	if (!impl->reached[0]) {
+		array<int, D> size;
+		size.fill(maxCoordinate(impl->obstacles, impl->decomposition));
+		for(auto& tree: impl->reached) tree.reset(new ReachedTree<D>(size));
+	}
+	IlluminateState<D>* sides[2] = {&impl->state, impl->backState.get()};
+	ReachedTree<D>* reached[2] = {impl->reached[0].get(), impl->reached[1].get()};
+	for(int i=0; i<2; ++i) {
+		IlluminateState<D>& state = *sides[i];
+		state.reset();
+		state.targets.reset({});
+		state.recordRects = true;
+		int cell = impl->locator.locate(i ? endP : startP);
+		assert(cell >= 0);
+		Box<D> box = i ? endBox : startBox;
+		reached[i]->clear();
+		reached[i]->add(box, {});
+		state.start(box, cell);
+	}
+	// The boxes reached from one side in a rounds and from the other side in
+	// b rounds are the points within a and b links. They intersect exactly
+	// when the distance is at most a+b, so the first intersection found while
+	// alternating the sides gives the distance.
+	int result = -1;
+	for(int side=0; ; side^=1) {
+		IlluminateState<D>& state = *sides[side];
+		if (state.finished()) break;
+		int step = state.curStep;
+		state.runRound();
+		if (step >= (int)state.rounds.size()) continue;
+		// Only the boxes of this round are new, so only they are checked
+		// against the boxes reached from the other side.
+		const auto& rects = state.rounds[step];
+		bool met = any_of(rects.begin(), rects.end(), [&](const IlluminatedRect<D>& rect) {
+			return reached[side^1]->check(rect.box);
+		});
+		if (met) {
+			result = sides[0]->curStep + sides[1]->curStep;
+			break;
 		}
-		state.newRound();
+		for(const auto& rect: rects) reached[side]->add(rect.box, {});
 	}
-	return state.endFound ? state.curStep : -1;
+	for(IlluminateState<D>* state: sides) state->recordRects = false;
+	return result;
+}
+
+template<int D>
+int linkDistance(const ObstacleSet<D>& obstacles, Point<D> startP, Point<D> endP) {
+	return LinkDistanceIndex<D>(obstacles).query(startP, endP);
+}
+
+template<int D>
+vector<int> linkDistances(const ObstacleSet<D>& obstacles, Point<D> startP, const vector<Point<D>>& endPs) {
+	return LinkDistanceIndex<D>(obstacles).query(startP, endPs);
+}
+
+template<int D>
+vector<Point<D>> minLinkPath(const ObstacleSet<D>& obstacles, Point<D> startP, Point<D> endP) {
+	return LinkDistanceIndex<D>(obstacles).path(startP, endP);
+}
+
+template<int D>
+int linkDistanceBidirectional(const ObstacleSet<D>& obstacles, Point<D> startP, Point<D> endP) {
+	return LinkDistanceIndex<D>(obstacles).queryBidirectional(startP, endP);
+}
+
+template<int D>
+int compressedLinkDistance(const ObstacleSet<D>& obstacles, Point<D> startP, Point<D> endP) {
+	CoordinateCompression<D> compression(obstacles, {startP, endP});
+	return linkDistance(compression.compress(obstacles),
+			compression.compress(startP), compression.compress(endP));
 }
 
+template<int D>
+vector<Point<D>> compressedMinLinkPath(const ObstacleSet<D>& obstacles, Point<D> startP, Point<D> endP) {
+	CoordinateCompression<D> compression(obstacles, {startP, endP});
+	vector<Point<D>> path = minLinkPath(compression.compress(obstacles),
+			compression.compress(startP), compression.compress(endP));
+	for(Point<D>& p: path) p = compression.expand(p);
+	return path;
+}
+
+template class LinkDistanceIndex<2>;
+template class LinkDistanceIndex<3>;
+template class LinkDistanceIndex<4>;
+
 template
 int linkDistance<2>(const ObstacleSet<2>& obstacles, Point<2> startP, Point<2> endP);
 template
 int linkDistance<3>(const ObstacleSet<3>& obstacles, Point<3> startP, Point<3> endP);
+template
+int linkDistance<4>(const ObstacleSet<4>& obstacles, Point<4> startP, Point<4> endP);
+template
+vector<int> linkDistances<2>(const ObstacleSet<2>& obstacles, Point<2> startP, const vector<Point<2>>& endPs);
+template
+vector<int> linkDistances<3>(const ObstacleSet<3>& obstacles, Point<3> startP, const vector<Point<3>>& endPs);
+template
+vector<int> linkDistances<4>(const ObstacleSet<4>& obstacles, Point<4> startP, const vector<Point<4>>& endPs);
+template
+int linkDistanceBidirectional<2>(const ObstacleSet<2>& obstacles, Point<2> startP, Point<2> endP);
+template
+int linkDistanceBidirectional<3>(const ObstacleSet<3>& obstacles, Point<3> startP, Point<3> endP);
+template
+int linkDistanceBidirectional<4>(const ObstacleSet<4>& obstacles, Point<4> startP, Point<4> endP);
+template
+int compressedLinkDistance<2>(const ObstacleSet<2>& obstacles, Point<2> startP, Point<2> endP);
+template
+int compressedLinkDistance<3>(const ObstacleSet<3>& obstacles, Point<3> startP, Point<3> endP);
+template
+int compressedLinkDistance<4>(const ObstacleSet<4>& obstacles, Point<4> startP, Point<4> endP);
+template
+vector<Point<2>> compressedMinLinkPath<2>(const ObstacleSet<2>& obstacles, Point<2> startP, Point<2> endP);
+template
+vector<Point<3>> compressedMinLinkPath<3>(const ObstacleSet<3>& obstacles, Point<3> startP, Point<3> endP);
+template
+vector<Point<4>> compressedMinLinkPath<4>(const ObstacleSet<4>& obstacles, Point<4> startP, Point<4> endP);
+template
+vector<Point<2>> minLinkPath<2>(const ObstacleSet<2>& obstacles, Point<2> startP, Point<2> endP);
+template
+vector<Point<3>> minLinkPath<3>(const ObstacleSet<3>& obstacles, Point<3> startP, Point<3> endP);
+template
+vector<Point<4>> minLinkPath<4>(const ObstacleSet<4>& obstacles, Point<4> startP, Point<4> endP);
@@ -2,5 +2,70 @@
 #include "Box.hpp"
 #include "decomposition.hpp"
 
+#include <memory>
+#include <vector>
+
+// Obstacle set preprocessed for repeated link distance queries. The free
+// space decomposition and the sweep plane are built once; a query only
+// resets the per-query illumination state.
+template<int D>
+class LinkDistanceIndex {
+public:
+	// The decomposition is built on the given number of threads, see
+	// decomposeFreeSpace.
+	explicit LinkDistanceIndex(const ObstacleSet<D>& obstacles, int threads = 1);
+	LinkDistanceIndex(LinkDistanceIndex&&);
+	LinkDistanceIndex& operator=(LinkDistanceIndex&&);
+	~LinkDistanceIndex();
+
+	// Returns the minimum number of links from startP to endP, or -1 if
+	// endP is not reachable.
+	int query(Point<D> startP, Point<D> endP);
+
+	// Returns the link distance from startP to each of endPs, computed
+	// with a single illumination that stops once all of them are reached.
+	std::vector<int> query(Point<D> startP, const std::vector<Point<D>>& endPs);
+
+	// Same as query(startP, endP), but illuminates alternately from both
+	// endpoints and stops when the illuminated regions meet.
+	int queryBidirectional(Point<D> startP, Point<D> endP);
+
+	// Returns the vertices of a rectilinear path from startP to endP with
+	// the minimum number of links, or an empty vector if endP is not
+	// reachable. Consecutive vertices differ in exactly one coordinate.
+	std::vector<Point<D>> path(Point<D> startP, Point<D> endP);
+
+	// Runs the 2*D directional sweeps of each illumination round on separate
+	// threads. Each direction then needs its own sweep plane.
+	void setParallelSweeps(bool parallel);
+
+	const Decomposition<D>& decomposition() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+};
+
 template<int D>
 int linkDistance(const ObstacleSet<D>& obstacles, Point<D> startP, Point<D> endP);
+
+template<int D>
+int linkDistanceBidirectional(const ObstacleSet<D>& obstacles, Point<D> startP, Point<D> endP);
+
+template<int D>
+std::vector<int> linkDistances(const ObstacleSet<D>& obstacles, Point<D> startP,
+		const std::vector<Point<D>>& endPs);
+
+template<int D>
+std::vector<Point<D>> minLinkPath(const ObstacleSet<D>& obstacles, Point<D> startP, Point<D> endP);
+
+// Same as linkDistance and minLinkPath, but on the obstacles mapped to the
+// ranks of their coordinates (see CoordinateCompression), so that the cost
+// depends on the number of distinct coordinates rather than their range.
+// LinkDistanceIndex does not compress, as its query points are not known
+// when it is built.
+template<int D>
+int compressedLinkDistance(const ObstacleSet<D>& obstacles, Point<D> startP, Point<D> endP);
+
+template<int D>
+std::vector<Point<D>> compressedMinLinkPath(const ObstacleSet<D>& obstacles, Point<D> startP, Point<D> endP);
@@ -34,6 +34,33 @@ Point<2> randomFreePoint(const vector<string>& grid, mt19937& rng) {
 	return res;
 }
 
+template<int D, class F>
+void checkPath(const vector<Point<D>>& path, Point<D> start, Point<D> end, int dist, F&& isFree) {
+	if (dist < 0) {
+		EXPECT_THAT(path, testing::IsEmpty());
+		return;
+	}
+	ASSERT_EQ((int)path.size(), dist+1);
+	EXPECT_EQ(path.front(), start);
+	EXPECT_EQ(path.back(), end);
+	for(size_t i=0; i+1<path.size(); ++i) {
+		Point<D> a = path[i], b = path[i+1];
+		int axis = -1;
+		for(int j=0; j<D; ++j) {
+			if (a[j] != b[j]) {
+				EXPECT_EQ(axis, -1) << a << ' ' << b;
+				axis = j;
+			}
+		}
+		ASSERT_NE(axis, -1);
+		int step = a[axis] < b[axis] ? 1 : -1;
+		for(Point<D> p = a; ; p[axis] += step) {
+			EXPECT_TRUE(isFree(p)) << p;
+			if (p == b) break;
+		}
+	}
+}
+
 TEST(LinkDistance2D, StartEndPointSame) {
 	ObstacleSet<2> obs = makeObstaclesForPlane({"."});
 	EXPECT_EQ(linkDistance(obs, {1,1}, {1,1}), 0);
@@ -98,6 +125,162 @@ TEST(LinkDistance2D, RandomTest) {
 	}
 }
 
+TEST(LinkDistance2D, IndexManyQueries) {
+	for(int i=0; i<5; ++i) {
+		mt19937 rng(i);
+		auto grid = genRandomGrid(24, 24, rng);
+		auto obs = makeObstaclesForPlane(grid);
+		LinkDistanceIndex<2> index(obs);
+		for(int j=0; j<10; ++j) {
+			Point<2> start = randomFreePoint(grid, rng);
+			Point<2> end = randomFreePoint(grid, rng);
+			EXPECT_EQ(index.query(start, end), slowLinkDistance(obs, start, end));
+			EXPECT_EQ(index.query(end, start), slowLinkDistance(obs, end, start));
+		}
+	}
+}
+
+TEST(LinkDistance2D, ManyTargets) {
+	for(int i=0; i<5; ++i) {
+		mt19937 rng(i);
+		auto grid = genRandomGrid(24, 24, rng);
+		auto obs = makeObstaclesForPlane(grid);
+		Point<2> start = randomFreePoint(grid, rng);
+		vector<Point<2>> targets = {start};
+		for(int j=0; j<20; ++j) targets.push_back(randomFreePoint(grid, rng));
+		vector<int> expected;
+		for(Point<2> t: targets) expected.push_back(slowLinkDistance(obs, start, t));
+		EXPECT_EQ(linkDistances(obs, start, targets), expected);
+	}
+}
+
+// Every free point is a target, most of them twice, so that most boxes
+// cover targets that are already resolved.
+TEST(LinkDistance2D, AllPointsTargets) {
+	mt19937 rng(3);
+	auto grid = genRandomGrid(16, 16, rng);
+	auto obs = makeObstaclesForPlane(grid);
+	Point<2> start = randomFreePoint(grid, rng);
+	vector<Point<2>> targets;
+	for(int y=0; y<(int)grid.size(); ++y) {
+		for(int x=0; x<(int)grid[y].size(); ++x) {
+			if (grid[y][x] != '.') continue;
+			targets.push_back({x+1, y+1});
+			if (rng()%4) targets.push_back({x+1, y+1});
+		}
+	}
+	LinkDistanceIndex<2> index(obs);
+	vector<int> expected;
+	for(Point<2> t: targets) expected.push_back(index.query(start, t));
+	EXPECT_EQ(index.query(start, targets), expected);
+}
+
+TEST(LinkDistance2D, BidirectionalSpiral) {
+	ObstacleSet<2> obs = makeObstaclesForPlane(
+		{".#.....",
+		 ".#.###.",
+		 ".#.#.#.",
+		 ".#...#.",
+		 ".#####.",
+		 "......."});
+	EXPECT_EQ(linkDistanceBidirectional(obs, {1,1}, {5,3}), 7);
+	EXPECT_EQ(linkDistanceBidirectional(obs, {5,3}, {1,1}), 7);
+}
+
+TEST(LinkDistance2D, BidirectionalRandom) {
+	for(int i=0; i<10; ++i) {
+		mt19937 rng(i);
+		auto grid = genRandomGrid(24, 24, rng);
+		auto obs = makeObstaclesForPlane(grid);
+		LinkDistanceIndex<2> index(obs);
+		for(int j=0; j<10; ++j) {
+			Point<2> start = randomFreePoint(grid, rng);
+			Point<2> end = j ? randomFreePoint(grid, rng) : start;
+			EXPECT_EQ(index.queryBidirectional(start, end), slowLinkDistance(obs, start, end));
+		}
+	}
+}
+
+TEST(LinkDistance2D, ParallelSweeps) {
+	for(int i=0; i<5; ++i) {
+		mt19937 rng(i);
+		auto grid = genRandomGrid(24, 24, rng);
+		auto obs = makeObstaclesForPlane(grid);
+		LinkDistanceIndex<2> index(obs);
+		index.setParallelSweeps(true);
+		for(int j=0; j<5; ++j) {
+			Point<2> start = randomFreePoint(grid, rng);
+			Point<2> end = randomFreePoint(grid, rng);
+			int dist = slowLinkDistance(obs, start, end);
+			EXPECT_EQ(index.query(start, end), dist);
+			EXPECT_EQ(index.queryBidirectional(start, end), dist);
+			checkPath<2>(index.path(start, end), start, end, dist,
+					[&](Point<2> p) { return grid[p[1]-1][p[0]-1] == '.'; });
+		}
+	}
+}
+
+ObstacleSet<2> scaleObstacles(ObstacleSet<2> obs, int factor) {
+	for(auto& o: obs) {
+		for(int i=0; i<2; ++i) {
+			o.box[i].from *= factor;
+			o.box[i].to *= factor;
+		}
+	}
+	return obs;
+}
+
+TEST(LinkDistance2D, CoordinateCompression) {
+	constexpr int F = 5;
+	for(int i=0; i<10; ++i) {
+		mt19937 rng(i);
+		auto grid = genRandomGrid(16, 16, rng);
+		auto obs = makeObstaclesForPlane(grid);
+		auto scaled = scaleObstacles(obs, F);
+		for(int j=0; j<5; ++j) {
+			Point<2> start = randomFreePoint(grid, rng);
+			Point<2> end = randomFreePoint(grid, rng);
+			int dist = linkDistance(obs, start, end);
+			Point<2> s{start[0]*F, start[1]*F}, e{end[0]*F, end[1]*F};
+			EXPECT_EQ(compressedLinkDistance(obs, start, end), dist);
+			EXPECT_EQ(compressedLinkDistance(scaled, s, e), dist);
+			checkPath<2>(compressedMinLinkPath(scaled, s, e), s, e, dist, [&](Point<2> p) {
+				return grid[p[1]/F-1][p[0]/F-1] == '.';
+			});
+		}
+	}
+}
+
+TEST(LinkDistance2D, PathSpiral) {
+	vector<string> grid = {
+		".#.....",
+		".#.###.",
+		".#.#.#.",
+		".#...#.",
+		".#####.",
+		"......."};
+	ObstacleSet<2> obs = makeObstaclesForPlane(grid);
+	auto path = minLinkPath(obs, {1,1}, {5,3});
+	checkPath<2>(path, {1,1}, {5,3}, 7, [&](Point<2> p) {
+		return grid[p[1]-1][p[0]-1] == '.';
+	});
+}
+
+TEST(LinkDistance2D, RandomPaths) {
+	for(int i=0; i<10; ++i) {
+		mt19937 rng(i);
+		auto grid = genRandomGrid(24, 24, rng);
+		auto obs = makeObstaclesForPlane(grid);
+		LinkDistanceIndex<2> index(obs);
+		for(int j=0; j<5; ++j) {
+			Point<2> start = randomFreePoint(grid, rng);
+			Point<2> end = randomFreePoint(grid, rng);
+			checkPath<2>(index.path(start, end), start, end, slowLinkDistance(obs, start, end),
+					[&](Point<2> p) { return grid[p[1]-1][p[0]-1] == '.'; });
+		}
+	}
+}
+
 TEST(LinkDistance3D, Triv) {
 	ObstacleSet<3> obs = makeObstaclesForVolume({
 		{
@@ -128,4 +311,126 @@ TEST(LinkDistance3D, AroundObstacle) {
 	EXPECT_EQ(linkDistance(obs, {1,1,1}, {1,2,2}), 5);
 }
 
+// The volume of AroundObstacle, with a start point and targets around the
+// obstacles and their distances from the start.
+class LinkDistance3DVolume : public testing::Test {
+protected:
+	LinkDistance3DVolume(): obs(makeObstaclesForVolume(volume)) {
+		for(Point<3> t: targets) expected.push_back(slowLinkDistance(obs, start, t));
+	}
+
+	bool isFree(Point<3> p) const {
+		return volume[p[2]-1][p[1]-1][p[0]-1] == '.';
+	}
+
+	const vector<vector<string>> volume = {
+		{
+			"...",
+			"###",
+			"...",
+		},{
+			"#..",
+			".#.",
+			"#..",
+		},{
+			"...",
+			".##",
+			"...",
+		}};
+	const ObstacleSet<3> obs;
+	const Point<3> start = {1,1,1};
+	const vector<Point<3>> targets = {{1,2,2}, {3,3,3}, {2,1,2}, {1,1,1}, {2,3,1}};
+	vector<int> expected;
+};
+
+// All targets are resolved by one illumination.
+TEST_F(LinkDistance3DVolume, ManyTargets) {
+	EXPECT_EQ(linkDistances(obs, start, targets), expected);
+}
+
+TEST_F(LinkDistance3DVolume, Path) {
+	LinkDistanceIndex<3> index(obs);
+	for(size_t i=0; i<targets.size(); ++i) {
+		checkPath<3>(index.path(start, targets[i]), start, targets[i], expected[i],
+				[&](Point<3> p) { return isFree(p); });
+	}
+}
+
+// Meeting in the middle gives the same distance in both directions.
+TEST_F(LinkDistance3DVolume, Bidirectional) {
+	LinkDistanceIndex<3> index(obs);
+	for(size_t i=0; i<targets.size(); ++i) {
+		EXPECT_EQ(index.queryBidirectional(start, targets[i]), expected[i]);
+		EXPECT_EQ(index.queryBidirectional(targets[i], start), expected[i]);
+	}
+}
+
+// The sweep threads are kept across rounds and queries, and switching
+// back to a single thread gives the same distances.
+TEST_F(LinkDistance3DVolume, ParallelSweeps) {
+	LinkDistanceIndex<3> index(obs);
+	index.setParallelSweeps(true);
+	for(int run=0; run<3; ++run) {
+		EXPECT_EQ(index.query(start, targets), expected)<<run;
+		for(size_t i=0; i<targets.size(); ++i) {
+			EXPECT_EQ(index.query(targets[i], start), expected[i])<<run;
+		}
+	}
+	index.setParallelSweeps(false);
+	EXPECT_EQ(index.query(start, targets), expected);
+}
+
+// A random grid for makeObstaclesForGrid and a free voxel in it, in the
+// coordinates of the obstacles.
+template<int D>
+vector<bool> genRandomVoxels(Point<D> size, mt19937& rng) {
+	int total = 1;
+	for(int i=0; i<D; ++i) total *= size[i];
+	vector<bool> res(total);
+	for(int i=0; i<total; ++i) res[i] = rng() < rng.max()/4;
+	return res;
+}
+
+template<int D>
+Point<D> randomFreeVoxel(Point<D> size, const vector<bool>& blocked, mt19937& rng) {
+	Point<D> res;
+	while(true) {
+		int index = 0;
+		for(int i=D-1; i>=0; --i) {
+			res[i] = rng()%size[i];
+			index = index*size[i] + res[i];
+		}
+		if (!blocked[index]) break;
+	}
+	for(int i=0; i<D; ++i) res[i] += 1;
+	return res;
+}
+
+template<int D>
+void checkRandomGrids(Point<D> size, int runs, int threads = 1) {
+	mt19937 rng(5);
+	for(int i=0; i<runs; ++i) {
+		vector<bool> blocked = genRandomVoxels<D>(size, rng);
+		ObstacleSet<D> obs = makeObstaclesForGrid<D>(size, blocked);
+		LinkDistanceIndex<D> index(obs, threads);
+		for(int j=0; j<5; ++j) {
+			Point<D> start = randomFreeVoxel<D>(size, blocked, rng);
+			Point<D> end = randomFreeVoxel<D>(size, blocked, rng);
+			EXPECT_EQ(index.query(start, end), slowLinkDistance(obs, start, end))<<i<<' '<<start<<' '<<end;
+		}
+	}
+}
+
+TEST(LinkDistance3D, RandomGrid) {
+	checkRandomGrids<3>({5, 4, 6}, 20);
+}
+
+TEST(LinkDistance3D, RandomGridParallelDecomposition) {
+	checkRandomGrids<3>({5, 4, 6}, 10, 3);
+}
+
+TEST(LinkDistance4D, RandomGrid) {
+	checkRandomGrids<4>({4, 3, 4, 3}, 10);
+}
+
 } // namespace
@@ -116,3 +116,5 @@ template
 int slowLinkDistance<2>(const ObstacleSet<2>& obstacles, Point<2> startP, Point<2> endP);
 template
 int slowLinkDistance<3>(const ObstacleSet<3>& obstacles, Point<3> startP, Point<3> endP);
+template
+int slowLinkDistance<4>(const ObstacleSet<4>& obstacles, Point<4> startP, Point<4> endP);